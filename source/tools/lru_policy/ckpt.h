@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+
+#if !defined(CKPT_H)
+#define CKPT_H
+
+namespace CKPT
+{
+
+// ---------------------------------------------------------------------------
+// Checkpoint file: a header, a section table, then 64-byte aligned sections
+// of plain fixed-size records. Nothing needs parsing, so a reader can mmap
+// the file and use the records in place.
+//
+//   Header | Section[count] | data ... (each section 64-byte aligned)
+// ---------------------------------------------------------------------------
+constexpr uint64_t MAGIC   = 0x74706b63757270ULL;  // "prucktp" -> lru ckpt
+constexpr uint32_t VERSION = 1;
+
+struct Header
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t count;       // entries in the section table
+};
+
+struct Section
+{
+    uint32_t id;          // what the section holds (caller-defined)
+    uint32_t key;         // instance, e.g. a thread id
+    uint64_t offset;      // from the start of the file
+    uint64_t bytes;
+};
+
+// ---------------------------------------------------------------------------
+// Collects sections in memory, then writes them out in one go.
+// ---------------------------------------------------------------------------
+class Writer
+{
+public:
+    void add(uint32_t id, uint32_t key, const void *data, uint64_t bytes)
+    {
+        sections.push_back({ id, key, 0, bytes });
+        const uint8_t *p = static_cast<const uint8_t*>(data);
+        blobs.emplace_back(p, p + bytes);
+    }
+
+    template<typename T>
+    void add(uint32_t id, uint32_t key, const std::vector<T> &v)
+    {
+        add(id, key, v.data(), v.size() * sizeof(T));
+    }
+
+    bool write(const char *path)
+    {
+        Header h = { MAGIC, VERSION, static_cast<uint32_t>(sections.size()) };
+        uint64_t off = align(sizeof(Header) + sections.size() * sizeof(Section));
+        for (auto &s : sections)
+        {
+            s.offset = off;
+            off = align(off + s.bytes);
+        }
+
+        FILE *f = std::fopen(path, "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+                  (sections.empty() ||
+                   std::fwrite(sections.data(), sizeof(Section), sections.size(), f) == sections.size());
+        for (size_t i = 0; ok && i < sections.size(); ++i)
+        {
+            ok = std::fseek(f, (long)sections[i].offset, SEEK_SET) == 0 &&
+                 (blobs[i].empty() ||
+                  std::fwrite(blobs[i].data(), 1, blobs[i].size(), f) == blobs[i].size());
+        }
+        return std::fclose(f) == 0 && ok;
+    }
+
+private:
+    static uint64_t align(uint64_t v) { return (v + 63) & ~uint64_t(63); }
+
+    std::vector<Section>              sections;
+    std::vector<std::vector<uint8_t>> blobs;
+};
+
+// ---------------------------------------------------------------------------
+// Maps a checkpoint read-only and hands out pointers into it.
+// ---------------------------------------------------------------------------
+class Reader
+{
+public:
+    ~Reader() { if (base) munmap(base, length); }
+
+    bool open(const char *path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(Header)) { close(fd); return false; }
+        length = st.st_size;
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return false;
+        base = static_cast<uint8_t*>(p);
+
+        const Header *h = reinterpret_cast<const Header*>(base);
+        if (h->magic != MAGIC || h->version != VERSION ||
+            sizeof(Header) + h->count * sizeof(Section) > length)
+            return false;
+        table = reinterpret_cast<const Section*>(base + sizeof(Header));
+        count = h->count;
+        for (uint32_t i = 0; i < count; ++i)
+            if (table[i].bytes && table[i].offset + table[i].bytes > length) return false;
+        return true;
+    }
+
+    // Returns the section's records (and their count), or nullptr.
+    template<typename T>
+    const T* find(uint32_t id, uint32_t key, uint64_t &n) const
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            if (table[i].id == id && table[i].key == key)
+            {
+                n = table[i].bytes / sizeof(T);
+                return reinterpret_cast<const T*>(base + table[i].offset);
+            }
+        n = 0;
+        return nullptr;
+    }
+
+    // Keys present for a section id (e.g. which threads have an L1 image).
+    std::vector<uint32_t> keys(uint32_t id) const
+    {
+        std::vector<uint32_t> k;
+        for (uint32_t i = 0; i < count; ++i)
+            if (table[i].id == id) k.push_back(table[i].key);
+        return k;
+    }
+
+private:
+    uint8_t       *base   = nullptr;
+    uint64_t       length = 0;
+    const Section *table  = nullptr;
+    uint32_t       count  = 0;
+};
+
+} // namespace CKPT
+
+#endif /* CKPT_H */
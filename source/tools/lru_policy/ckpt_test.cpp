@@ -0,0 +1,59 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include "ckpt.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Round trip of several sections  o
+// Keyed sections (per thread)     o
+// Missing section / bad file      o
+// -----------------------------------------------------------------------
+
+struct Rec { uint64_t a; uint32_t b, c; };
+
+int main()
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/tmp/ckpt_test.%d", (int)getpid());
+
+    std::vector<Rec> recs;
+    for (uint32_t i = 0; i < 1000; i++) recs.push_back({ i * 3ULL, i, ~i });
+    uint64_t one = 42;
+
+    CKPT::Writer w;
+    w.add(1, 0, &one, sizeof(one));
+    w.add(2, 0, recs);
+    w.add(3, 7, recs.data(), 10 * sizeof(Rec));
+    w.add(3, 9, recs.data(), 0);
+    assert(w.write(path));
+
+    {
+        CKPT::Reader r;
+        assert(r.open(path));
+        uint64_t n;
+        const uint64_t *v = r.find<uint64_t>(1, 0, n);
+        assert(v && n == 1 && *v == 42);
+        const Rec *p = r.find<Rec>(2, 0, n);
+        assert(p && n == 1000 && p[999].a == 2997 && p[999].c == ~999u);
+        assert(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+        p = r.find<Rec>(3, 7, n);
+        assert(p && n == 10 && p[9].b == 9);
+        r.find<Rec>(3, 9, n);
+        assert(n == 0);
+        assert(r.keys(3).size() == 2);
+        assert(!r.find<Rec>(4, 0, n) && n == 0);
+    }
+
+    FILE *f = std::fopen(path, "r+b");
+    std::fputc('x', f);                     // break the magic
+    std::fclose(f);
+    CKPT::Reader bad;
+    assert(!bad.open(path));
+    unlink(path);
+
+    std::cout << "checkpoint ok" << std::endl;
+    return 0;
+}
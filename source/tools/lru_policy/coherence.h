@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#if !defined(COHERENCE_H)
+#define COHERENCE_H
+
+namespace COH
+{
+
+// ---------------------------------------------------------------------------
+// Line states as the directory sees them. With MOESI a read of a modified
+// line leaves the writer as Owner (dirty, supplying data) instead of
+// forcing a write-back.
+// ---------------------------------------------------------------------------
+enum Protocol : uint8_t { MESI, MOESI };
+enum State    : uint8_t { I, S, E, O, M };
+
+// Sharer sets are 64-bit masks: threads 0..62 get their own bit, the rest
+// share bit 63, which the caller treats as a broadcast to all of them.
+constexpr uint32_t WIDE = 63;
+inline uint64_t bit(uint32_t tid) { return 1ULL << (tid < WIDE ? tid : WIDE); }
+
+// Byte mask of [off, off+size) in a line of `blk` bytes, one bit per
+// blk/64 bytes.
+inline uint64_t byte_mask(uint32_t off, uint32_t size, uint32_t blk)
+{
+    uint32_t gran = blk > 64 ? blk / 64 : 1;
+    uint32_t end  = off + (size ? size : 1);
+    if (end > blk) end = blk;
+    uint32_t lo = off / gran, hi = (end - 1) / gran;
+    uint64_t upto = hi >= 63 ? ~0ULL : (2ULL << hi) - 1;
+    return upto & ~((1ULL << lo) - 1);
+}
+
+struct Entry
+{
+    uint64_t sharers = 0;   // who may hold a copy
+    uint64_t lost    = 0;   // copies killed by a write and not re-fetched
+    uint64_t written = 0;   // bytes written since `lost` became non-empty
+    uint32_t owner   = 0;   // holder in E, O or M
+    State    state   = I;
+};
+
+// What the caller must do to the private caches, and how to count it.
+struct Outcome
+{
+    uint64_t invalidate = 0;      // drop these sharers' copies
+    bool     downgrade  = false;  // `owner` loses exclusivity (read of E/M)
+    bool     writeback  = false;  // ... and cleans its dirty copy (MESI)
+    uint32_t owner      = 0;
+    bool     coherence_miss = false;   // refetch of a copy lost to a write
+    bool     false_sharing  = false;   // ... touching none of the bytes written
+};
+
+// ---------------------------------------------------------------------------
+// Full-map directory for the private caches above the shared level. It
+// only tracks state; the caller locks it and applies each Outcome.
+// ---------------------------------------------------------------------------
+class Directory
+{
+public:
+    explicit Directory(Protocol p = MESI) : proto(p) {}
+
+    // A thread without a private copy reads the line.
+    Outcome read(uint64_t line, uint32_t tid, uint64_t bytes)
+    {
+        Entry &e = lines[line];
+        Outcome o = refetch(e, tid, bytes);
+        bool mine = e.owner == tid && e.state != I && e.state != S;
+        if (!mine) switch (e.state)
+        {
+        case I:
+            e.state = E; e.owner = tid;
+            break;
+        case E:
+            o.downgrade = true; o.owner = e.owner;
+            e.state = S;
+            break;
+        case M:
+            o.downgrade = true; o.owner = e.owner;
+            if (proto == MOESI) e.state = O;
+            else { o.writeback = true; e.state = S; }
+            break;
+        case S: case O:
+            break;
+        }
+        e.sharers |= bit(tid);
+        return o;
+    }
+
+    // A thread writes the line; every other copy is invalidated.
+    Outcome write(uint64_t line, uint32_t tid, uint64_t bytes)
+    {
+        Entry &e = lines[line];
+        Outcome o = refetch(e, tid, bytes);
+        o.invalidate = e.sharers & ~(tid < WIDE ? bit(tid) : 0);
+        if (o.invalidate && !e.lost) e.written = 0;
+        e.lost    |= o.invalidate;
+        if (e.lost) e.written |= bytes;
+        e.sharers  = bit(tid);
+        e.owner    = tid;
+        e.state    = M;
+        return o;
+    }
+
+    // A thread no longer holds the line in any private cache.
+    void leave(uint64_t line, uint32_t tid)
+    {
+        auto it = lines.find(line);
+        if (it == lines.end()) return;
+        Entry &e = it->second;
+        if (tid < WIDE) e.sharers &= ~bit(tid);
+        if (e.owner == tid && e.state != S) e.state = e.sharers ? S : I;
+        if (!e.sharers) e.state = I;
+        if (!e.sharers && !e.lost) lines.erase(it);
+    }
+
+    const Entry* find(uint64_t line) const
+    {
+        auto it = lines.find(line);
+        return it == lines.end() ? nullptr : &it->second;
+    }
+
+    size_t size() const { return lines.size(); }
+
+private:
+    // A thread whose copy was invalidated comes back for the line.
+    static Outcome refetch(Entry &e, uint32_t tid, uint64_t bytes)
+    {
+        Outcome o;
+        if (e.lost & bit(tid))
+        {
+            o.coherence_miss = true;
+            o.false_sharing  = !(e.written & bytes);
+            e.lost &= ~bit(tid);
+            if (!e.lost) e.written = 0;
+        }
+        return o;
+    }
+
+    Protocol                               proto;
+    std::unordered_map<uint64_t, Entry>    lines;
+};
+
+} // namespace COH
+
+#endif /* COHERENCE_H */
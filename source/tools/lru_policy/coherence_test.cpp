@@ -0,0 +1,66 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include "coherence.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// E on first read, S on second  o
+// Write invalidates sharers     o
+// MESI write-back / MOESI owner o
+// True vs false sharing         o
+// Leave drops the entry         o
+// Byte masks                    o
+// -----------------------------------------------------------------------
+
+int main()
+{
+    using namespace COH;
+    const uint64_t A = 0x1000;
+    uint64_t lo = byte_mask(0, 8, 64), hi = byte_mask(32, 8, 64);
+    assert(lo == 0xff && hi == 0xffULL << 32);
+    assert(byte_mask(60, 8, 64) == 0xfULL << 60);      // clipped at the line end
+    assert(byte_mask(0, 4, 128) == 3 && byte_mask(126, 2, 128) == 1ULL << 63);
+
+    Directory d(MESI);
+    Outcome o = d.read(A, 0, lo);
+    assert(!o.downgrade && d.find(A)->state == E && d.find(A)->owner == 0);
+    o = d.read(A, 1, lo);
+    assert(o.downgrade && !o.writeback && o.owner == 0 && d.find(A)->state == S);
+
+    // thread 1 writes the high half: thread 0 loses its copy
+    o = d.write(A, 1, hi);
+    assert(o.invalidate == bit(0) && d.find(A)->state == M);
+
+    // thread 0 rereads the low half: coherence miss, false sharing,
+    // and the dirty owner must write back under MESI
+    o = d.read(A, 0, lo);
+    assert(o.coherence_miss && o.false_sharing);
+    assert(o.downgrade && o.writeback && o.owner == 1 && d.find(A)->state == S);
+
+    // true sharing: 0 writes the low half, 1 rereads it
+    o = d.write(A, 0, lo);
+    assert(o.invalidate == bit(1));
+    o = d.read(A, 1, lo);
+    assert(o.coherence_miss && !o.false_sharing);
+
+    Directory m(MOESI);
+    m.write(A, 2, lo);
+    o = m.read(A, 3, lo);
+    assert(o.downgrade && !o.writeback && m.find(A)->state == O && m.find(A)->owner == 2);
+
+    // owner and sharer leave: the entry goes away
+    m.leave(A, 2);
+    assert(m.find(A)->state == S);
+    m.leave(A, 3);
+    assert(!m.find(A) && m.size() == 0);
+
+    // wide thread ids share the last bit
+    assert(bit(63) == bit(500));
+    o = d.write(A, 100, lo);
+    assert(o.invalidate == (bit(0) | bit(1)));
+    o = d.write(A, 200, lo);
+    assert(o.invalidate & bit(WIDE));
+
+    std::cout << "coherence ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if !defined(DAMON_H)
+#define DAMON_H
+
+namespace DAMON
+{
+
+// ---------------------------------------------------------------------------
+// Monitoring parameters. A sample checks one page per region; every
+// `aggr_samples` samples the counts are aggregated, regions merged and
+// split. Region count stays within [min_regions, max_regions].
+// ---------------------------------------------------------------------------
+struct Config
+{
+    uint32_t min_regions  = 10;
+    uint32_t max_regions  = 1000;
+    uint32_t aggr_samples = 20;
+    uint64_t seed         = 1;
+};
+
+// Pages [lo, hi).
+struct Region
+{
+    uint64_t lo, hi;
+    uint64_t sample           = 0;  // page whose accessed bit is watched
+    uint32_t nr_accesses      = 0;  // samples that found it accessed
+    uint32_t last_nr_accesses = 0;  // ... in the last aggregation
+    uint32_t age              = 0;  // aggregations with a similar count
+
+    uint64_t pages() const { return hi - lo; }
+};
+
+struct Stats
+{
+    uint64_t samples = 0, aggregations = 0, merges = 0, splits = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Region-based access monitor after Linux DAMON (mm/damon/core.c). The
+// monitored address space is split into regions assumed to be accessed
+// alike, so checking one random page per region per sample estimates each
+// region's access frequency at a cost bounded by max_regions, whatever the
+// working set. At each aggregation, neighbours whose counts differ by at
+// most a tenth of the highest count are merged (up to a size limit of the
+// total over min_regions), then, while there is room, every region is
+// split at a random point so hot and cold parts can separate.
+//
+// The caller owns the accessed bits: `sample` takes a test-and-clear
+// function, called once per region to check the page picked last time and
+// once more (result ignored) to clear the next one.
+// ---------------------------------------------------------------------------
+class Monitor
+{
+public:
+    explicit Monitor(const Config &c = Config()) : cfg(c), rng(c.seed ? c.seed : 1)
+    {
+        if (cfg.min_regions < 3) cfg.min_regions = 3;
+        if (cfg.max_regions < cfg.min_regions) cfg.max_regions = cfg.min_regions;
+        if (!cfg.aggr_samples) cfg.aggr_samples = 1;
+    }
+
+    // Fit the regions to new monitoring target ranges, sorted and disjoint
+    // (damon_set_regions): regions outside them go, regions across an edge
+    // are trimmed, uncovered parts become new regions. A range left with
+    // no region is cut evenly so there are at least min_regions overall.
+    void set_ranges(const std::vector<std::pair<uint64_t, uint64_t>> &ranges)
+    {
+        std::vector<Region> out;
+        size_t i = 0;
+        for (auto &rg : ranges)
+        {
+            if (rg.second <= rg.first) continue;
+            uint64_t at = rg.first;
+            while (i < regs.size() && regs[i].hi <= rg.first) ++i;
+            size_t before = out.size();
+            for (; i < regs.size() && regs[i].lo < rg.second; ++i)
+            {
+                Region r = regs[i];
+                r.lo = std::max(r.lo, rg.first);
+                r.hi = std::min(r.hi, rg.second);
+                if (r.lo > at) out.push_back(fresh(at, r.lo));
+                if (r.sample < r.lo || r.sample >= r.hi) r.sample = pick(r);
+                out.push_back(r);
+                at = r.hi;
+                if (regs[i].hi > rg.second) break;  // may continue into the next range
+            }
+            if (at < rg.second)
+            {
+                if (out.size() == before)
+                {
+                    uint64_t want = (cfg.min_regions + ranges.size() - 1) / ranges.size();
+                    uint64_t n = std::min<uint64_t>(rg.second - rg.first, want);
+                    uint64_t step = (rg.second - rg.first) / n;
+                    for (uint64_t k = 0; k < n; ++k)
+                        out.push_back(fresh(rg.first + k * step, k + 1 == n ? rg.second : rg.first + (k + 1) * step));
+                }
+                else out.push_back(fresh(at, rg.second));
+            }
+        }
+        regs.swap(out);
+    }
+
+    // One sampling interval. True when it ended an aggregation; regions()
+    // then carry the aggregated counts in last_nr_accesses.
+    template <class F>
+    bool sample(F test_and_clear)
+    {
+        for (auto &r : regs)
+            if (test_and_clear(r.sample)) ++r.nr_accesses;
+        ++st.samples;
+
+        bool aggregated = ++nsamples >= cfg.aggr_samples;
+        if (aggregated)
+        {
+            nsamples = 0;
+            aggregate();
+        }
+        for (auto &r : regs)
+        {
+            r.sample = pick(r);
+            test_and_clear(r.sample);
+        }
+        return aggregated;
+    }
+
+    const std::vector<Region>& regions() const { return regs; }
+    uint64_t     pages() const { uint64_t n = 0; for (auto &r : regs) n += r.pages(); return n; }
+    const Stats& stats() const { return st; }
+    void         reset_stats() { st = Stats(); }
+
+private:
+    uint64_t rand() { rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17; return rng; }
+    uint64_t pick(const Region &r) { return r.lo + rand() % r.pages(); }
+
+    Region fresh(uint64_t lo, uint64_t hi)
+    {
+        Region r;
+        r.lo = lo;
+        r.hi = hi;
+        r.sample = pick(r);
+        return r;
+    }
+
+    void aggregate()
+    {
+        ++st.aggregations;
+        uint32_t max_nr = 0;
+        for (auto &r : regs) max_nr = std::max(max_nr, r.nr_accesses);
+        uint32_t thres = std::max<uint32_t>(1, max_nr / 10);
+
+        // ages, then merges (kdamond_merge_regions)
+        for (auto &r : regs)
+        {
+            uint32_t d = r.nr_accesses > r.last_nr_accesses ? r.nr_accesses - r.last_nr_accesses
+                                                            : r.last_nr_accesses - r.nr_accesses;
+            r.age = d > thres ? 0 : r.age + 1;
+        }
+        uint64_t sz_limit = std::max<uint64_t>(1, pages() / cfg.min_regions);
+        std::vector<Region> out;
+        for (auto &r : regs)
+        {
+            if (!out.empty())
+            {
+                Region &p = out.back();
+                uint32_t d = p.nr_accesses > r.nr_accesses ? p.nr_accesses - r.nr_accesses
+                                                           : r.nr_accesses - p.nr_accesses;
+                if (p.hi == r.lo && d <= thres && p.pages() + r.pages() <= sz_limit)
+                {
+                    uint64_t a = p.pages(), b = r.pages();
+                    p.nr_accesses = (uint32_t)((p.nr_accesses * a + r.nr_accesses * b) / (a + b));
+                    p.age         = (uint32_t)((p.age * a + r.age * b) / (a + b));
+                    p.hi = r.hi;
+                    ++st.merges;
+                    continue;
+                }
+            }
+            out.push_back(r);
+        }
+        regs.swap(out);
+
+        for (auto &r : regs)
+        {
+            r.last_nr_accesses = r.nr_accesses;
+            r.nr_accesses = 0;
+        }
+
+        // split each region in two, or three if merging undid the last
+        // split and there is room
+        if (regs.size() > cfg.max_regions / 2) return;
+        uint32_t parts = regs.size() == last_nr_regions && regs.size() < cfg.max_regions / 3 ? 3 : 2;
+        last_nr_regions = regs.size();
+        out.clear();
+        for (auto &r : regs)
+        {
+            Region rest = r;
+            for (uint32_t k = 1; k < parts && rest.pages() >= 2; ++k)
+            {
+                // at 10%..90% of what is left
+                uint64_t cut = rest.lo + std::max<uint64_t>(1, (1 + rand() % 9) * rest.pages() / 10);
+                if (cut >= rest.hi) break;
+                Region left = rest;
+                left.hi = cut;
+                left.sample = pick(left);
+                out.push_back(left);
+                rest.lo = cut;
+                ++st.splits;
+            }
+            rest.sample = pick(rest);
+            out.push_back(rest);
+        }
+        regs.swap(out);
+    }
+
+    Config              cfg;
+    uint64_t            rng;
+    uint32_t            nsamples = 0;
+    size_t              last_nr_regions = 0;  // before the last split
+    std::vector<Region> regs;       // sorted by address
+    Stats               st;
+};
+
+// ---------------------------------------------------------------------------
+// DAMON's virtual address target: the mappings' bounds less the two largest
+// gaps, typically leaving heap, mmap area and stack as three ranges.
+// `maps` is sorted [lo, hi) pages.
+// ---------------------------------------------------------------------------
+inline std::vector<std::pair<uint64_t, uint64_t>>
+three_regions(const std::vector<std::pair<uint64_t, uint64_t>> &maps)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> out;
+    if (maps.empty()) return out;
+    size_t g1 = 0, g2 = 0;      // indices after the two largest gaps
+    uint64_t s1 = 0, s2 = 0;
+    for (size_t i = 1; i < maps.size(); ++i)
+    {
+        uint64_t gap = maps[i].first > maps[i - 1].second ? maps[i].first - maps[i - 1].second : 0;
+        if (gap > s1)      { g2 = g1; s2 = s1; g1 = i; s1 = gap; }
+        else if (gap > s2) { g2 = i; s2 = gap; }
+    }
+    size_t cuts[2] = { std::min(g1, g2), std::max(g1, g2) };
+    size_t from = 0;
+    for (size_t c : cuts)
+    {
+        if (!c || c == from) continue;
+        out.push_back({ maps[from].first, maps[c - 1].second });
+        from = c;
+    }
+    out.push_back({ maps[from].first, maps.back().second });
+    return out;
+}
+
+} // namespace DAMON
+
+#endif /* DAMON_H */
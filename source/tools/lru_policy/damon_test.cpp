@@ -0,0 +1,89 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "damon.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Three-region target from mappings  o
+// Initial regions cover the target   o
+// Region count stays bounded         o
+// Hot range found, cold range not    o
+// set_ranges trims and fills         o
+// -----------------------------------------------------------------------
+
+using namespace DAMON;
+
+typedef std::vector<std::pair<uint64_t, uint64_t>> Ranges;
+
+// Sorted, disjoint, and exactly covering `ranges`.
+static void covers(const Monitor &m, const Ranges &ranges)
+{
+    const auto &r = m.regions();
+    size_t i = 0;
+    for (auto &rg : ranges)
+    {
+        assert(i < r.size() && r[i].lo == rg.first);
+        while (r[i].hi < rg.second)
+        {
+            assert(r[i].lo < r[i].hi && r[i].hi == r[i + 1].lo);
+            assert(r[i].sample >= r[i].lo && r[i].sample < r[i].hi);
+            ++i;
+        }
+        assert(r[i].hi == rg.second);
+        ++i;
+    }
+    assert(i == r.size());
+}
+
+int main()
+{
+    // heap, libraries and stack, with small gaps inside each
+    Ranges maps = { { 100, 200 }, { 210, 300 }, { 100000, 100050 }, { 100060, 100100 },
+                    { 900000, 900010 } };
+    Ranges three = three_regions(maps);
+    assert(three.size() == 3);
+    assert(three[0] == Ranges::value_type(100, 300));
+    assert(three[1] == Ranges::value_type(100000, 100100));
+    assert(three[2] == Ranges::value_type(900000, 900010));
+    assert(three_regions({ { 5, 9 } }).size() == 1);
+
+    Config c;
+    c.min_regions = 10; c.max_regions = 100; c.aggr_samples = 20;
+    Monitor m(c);
+    m.set_ranges(three);
+    assert(m.regions().size() >= 10);
+    covers(m, three);
+
+    // pages [2000, 3000) of [0, 10000) are used all the time
+    Ranges all = { { 0, 10000 } };
+    Monitor d(c);
+    d.set_ranges(all);
+    std::vector<bool> accessed(10000, false);
+    auto check = [&](uint64_t p) { bool a = accessed[p]; accessed[p] = false; return a; };
+    for (int s = 0; s < 20 * 30; ++s)
+    {
+        for (uint64_t p = 2000; p < 3000; ++p) accessed[p] = true;
+        d.sample(check);
+        assert(d.regions().size() <= c.max_regions);
+        covers(d, all);
+    }
+    uint64_t hot = 0, hot_in = 0;
+    for (auto &r : d.regions())
+    {
+        if (r.last_nr_accesses < c.aggr_samples / 2) continue;
+        hot += r.pages();
+        hot_in += std::min<uint64_t>(r.hi, 3000) - std::max<uint64_t>(r.lo, std::min<uint64_t>(r.hi, 2000));
+        if (r.lo >= 3000 || r.hi <= 2000) assert(!"cold region counted as hot");
+    }
+    assert(hot >= 800 && hot <= 1300 && hot_in >= 800);
+    assert(d.stats().aggregations == 30 && d.stats().merges && d.stats().splits);
+
+    // shrink the target: trimmed at both ends, a new tail region added
+    Ranges less = { { 500, 9000 }, { 12000, 12100 } };
+    d.set_ranges(less);
+    covers(d, less);
+
+    std::cout << "damon ok" << std::endl;
+    return 0;
+}
@@ -4,7 +4,9 @@
 #include <iostream>
 #include <vector>
 #include <cstdint>
+#include <algorithm>
 #include <unordered_map>
+#include "shmarena.h"
 
 #if !defined(HASHLL_H)
 #define HASHLL_H
@@ -24,24 +26,37 @@ public:
     // -----------------------------------------------------------------------
     struct hash_node
     {
-        uint64_t  vp_num;         // virtual‐page number (addr >> 12)
+        uint64_t  vp_num;         // virtual‐page number (addr >> page_shift)
         uint64_t  access_count;   // number of times this page was accessed
+        uint32_t  csize;          // bytes charged against the byte budget
+        uint32_t  writes;         // write misses + dirty write-backs seen
+        bool      dirty;          // modified since last (re)compression
+        bool      code;           // instructions were fetched from it
+        bool      stale;          // written since its compressed size was estimated
+        uint32_t  sharers;        // threads that accessed it, bit (tid % 32)
         hash_node *next;          // newer (MRU) in the LRU list
         hash_node *prev;          // older (LRU) in the LRU list
 
-        // Constructor now takes full virtual address, not vp_num:
-        hash_node(uint64_t vp_addr)
-            : vp_num(addr_to_num(vp_addr)), access_count(1),
-              next(nullptr), prev(nullptr) {}
+        // Takes the page number; the owning list does the conversion
+        // since it knows the page size.
+        explicit hash_node(uint64_t num)
+            : vp_num(num), access_count(1), csize(0),
+              writes(0), dirty(false), code(false), stale(false), sharers(0), next(nullptr), prev(nullptr) {}
     };
 
     // -----------------------------------------------------------------------
-    // Construct an LRU list that can hold up to `capacity` distinct pages.
+    // Construct an LRU list that can hold up to `capacity` distinct pages
+    // of (1 << page_shift) bytes each. With an arena, nodes and the hash
+    // table are allocated from it (e.g. a segment shared between processes);
+    // otherwise from the heap.
     // -----------------------------------------------------------------------
-    explicit HashLL(uint32_t capacity)
-        : cap(capacity), size(0), head(nullptr), tail(nullptr)
+    explicit HashLL(uint32_t capacity, uint32_t page_shift = 12,
+                    SHMARENA::Arena *arena = nullptr)
+        : shift(page_shift), cap(capacity), size(0), head(nullptr), tail(nullptr),
+          cap_bytes(0), used_bytes(0), arena(arena),
+          table(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), TableAlloc(arena))
     {
-        table.reserve(capacity * 2);
+        table.reserve(static_cast<size_t>(std::min(capacity, RESERVE_MAX)) * 2);
     }
 
     ~HashLL()
@@ -51,7 +66,7 @@ public:
         while (cur)
         {
             hash_node *nxt = cur->next;
-            delete cur;
+            free_node(cur);
             cur = nxt;
         }
         // The unordered_map destructor will clean itself up automatically
@@ -80,8 +95,8 @@ public:
         else
         {
             // New page: create node using full address
-            hash_node *n = new hash_node(vp_addr);
-            table[vp_num] = n;
+            hash_node *n = alloc_node(vp_num);
+            index_node(n);
             insert_at_head(n);
             if (size < cap)
             {
@@ -93,7 +108,9 @@ public:
                 hash_node *ev = tail;
                 unlink_node(ev);
                 table.erase(ev->vp_num);
-                delete ev;
+                used_bytes -= ev->csize;
+                notify_evict(ev);
+                free_node(ev);
             }
         }
     }
@@ -103,6 +120,73 @@ public:
     // -----------------------------------------------------------------------
     size_t get_size() const { return size; }
     size_t get_cap()  const { return cap;  }
+    uint32_t get_page_shift() const { return shift; }
+    uint64_t get_used_bytes() const { return used_bytes; }
+    uint64_t get_byte_cap()   const { return cap_bytes;  }
+
+    // -----------------------------------------------------------------------
+    // Enforce a byte budget on top of the page capacity (0 disables it).
+    // Pages are charged whatever set_csize() says they cost.
+    // -----------------------------------------------------------------------
+    void set_byte_cap(uint64_t bytes) { cap_bytes = bytes; }
+
+    // -----------------------------------------------------------------------
+    // Called with every node the list evicts by itself (page cap or byte
+    // budget), just before it is freed; not for remove()/remove_range() or
+    // swap_with(). The callback is process-local, so lists shared between
+    // processes should leave it unset.
+    // -----------------------------------------------------------------------
+    typedef void (*evict_fn)(const hash_node &n, void *ctx);
+    void on_evict(evict_fn fn, void *ctx) { evict_cb = fn; evict_ctx = ctx; }
+
+    // -----------------------------------------------------------------------
+    // Change the page capacity, evicting from the LRU end until both the
+    // page cap and the byte budget hold. Returns the number of pages evicted.
+    // -----------------------------------------------------------------------
+    uint32_t resize(uint32_t capacity)
+    {
+        cap = capacity;
+        uint32_t evicted = 0;
+        while (tail && (size > cap || (cap_bytes && used_bytes > cap_bytes)))
+        {
+            hash_node *ev = tail;
+            unlink_node(ev);
+            table.erase(ev->vp_num);
+            used_bytes -= ev->csize;
+            --size;
+            notify_evict(ev);
+            free_node(ev);
+            ++evicted;
+        }
+        return evicted;
+    }
+
+    // -----------------------------------------------------------------------
+    // Charge a page `bytes` against the byte budget, then evict from the LRU
+    // end until the list fits again. The charged page itself is only evicted
+    // if nothing else is left. Returns the number of pages evicted.
+    // -----------------------------------------------------------------------
+    uint32_t set_csize(uint64_t vp_addr, uint32_t bytes)
+    {
+        hash_node *n = find_node(vp_addr);
+        if (!n) return 0;
+        used_bytes = used_bytes - n->csize + bytes;
+        n->csize   = bytes;
+
+        uint32_t evicted = 0;
+        while (cap_bytes && used_bytes > cap_bytes && size > 1)
+        {
+            hash_node *ev = (tail == n) ? n->prev : tail;
+            unlink_node(ev);
+            table.erase(ev->vp_num);
+            used_bytes -= ev->csize;
+            --size;
+            notify_evict(ev);
+            free_node(ev);
+            ++evicted;
+        }
+        return evicted;
+    }
 
     // -----------------------------------------------------------------------
     // Make a node MRU, moving it to the front of the list.
@@ -169,8 +253,8 @@ public:
     {
         uint64_t vp_num = addr_to_num(vp_addr);
         if (table.count(vp_num)) return;      // already in list
-        hash_node* n = new hash_node(vp_addr);
-        table[vp_num] = n;
+        hash_node* n = alloc_node(vp_num);
+        index_node(n);
         // append at tail
         n->next = nullptr;
         n->prev = tail;
@@ -196,10 +280,53 @@ public:
         hash_node *n = it->second;
         unlink_node(n);
         table.erase(it);
-        delete n;
+        used_bytes -= n->csize;
+        free_node(n);
         --size;
     }
 
+    // -----------------------------------------------------------------------
+    // Remove every page overlapping [lo, hi). Probes the table page by page
+    // when the range is smaller than the list, otherwise walks the list once.
+    // Returns the number of pages removed.
+    // -----------------------------------------------------------------------
+    uint32_t remove_range(uint64_t lo, uint64_t hi)
+    {
+        if (hi <= lo || !size) return 0;
+        uint64_t first = addr_to_num(lo);
+        uint64_t last  = addr_to_num(hi - 1);
+        uint32_t removed = 0;
+
+        auto drop = [&](hash_node *n)
+        {
+            unlink_node(n);
+            table.erase(n->vp_num);
+            used_bytes -= n->csize;
+            free_node(n);
+            --size;
+            ++removed;
+        };
+
+        if (last - first < size)
+        {
+            for (uint64_t v = first; v <= last && size; ++v)
+            {
+                auto it = table.find(v);
+                if (it != table.end()) drop(it->second);
+            }
+        }
+        else
+        {
+            for (hash_node *cur = head; cur != nullptr; )
+            {
+                hash_node *next = cur->next;
+                if (cur->vp_num >= first && cur->vp_num <= last) drop(cur);
+                cur = next;
+            }
+        }
+        return removed;
+    }
+
     void increment_count(uint64_t vp_addr)
     {
         uint64_t vp_num = addr_to_num(vp_addr);
@@ -230,7 +357,7 @@ public:
     // -----------------------------------------------------------------------
     bool isFull() const
     {
-        return size >= cap;
+        return size >= cap || (cap_bytes && used_bytes >= cap_bytes);
     }
 
     // -----------------------------------------------------------------------
@@ -259,6 +386,16 @@ public:
         return v;
     }
 
+    // -----------------------------------------------------------------------
+    // Visit every node in LRU order (MRU first).
+    // -----------------------------------------------------------------------
+    template<typename F>
+    void for_each(F f) const
+    {
+        for (hash_node *cur = head; cur; cur = cur->next)
+            f(*cur);
+    }
+
     // -----------------------------------------------------------------------
     // For debugging: return the head pointer of the LRU list.
     // -----------------------------------------------------------------------
@@ -277,7 +414,8 @@ public:
         head = n;
         if (!tail) tail = n;
         ++size;
-        table[n->vp_num] = n;
+        used_bytes += n->csize;
+        index_node(n);
     }
 
     // -------------------------------------------------------------------
@@ -291,7 +429,8 @@ public:
         tail = n;
         if (!head) head = n;
         ++size;
-        table[n->vp_num] = n;
+        used_bytes += n->csize;
+        index_node(n);
     }
 
     // -------------------------------------------------------------------
@@ -301,25 +440,33 @@ public:
     // After swap:
     //   candidate goes MRU into other
     //   victim    goes LRU into this
+    // Byte charges do not travel: both nodes arrive uncharged, and the
+    // victim (returned) is left for the caller to charge via set_csize().
+    // A caller that already looked up the candidate may pass it as `hot`.
     // -------------------------------------------------------------------
-    void swap_with(HashLL& other)
+    hash_node* swap_with(HashLL& other, hash_node* hot = nullptr)
     {
-        hash_node* hot  = hottest_node();   // from *this*  (clist)
+        if (!hot) hot = hottest_node();     // from *this*  (clist)
         hash_node* cold = other.lru_node(); // from other   (unclist)
-        if (!hot || !cold) return;
+        if (!hot || !cold) return nullptr;
 
         // --- detach from their original owners ---
         unlink_node(hot);                         // correct: *this*
         table.erase(hot->vp_num);
+        used_bytes -= hot->csize;
+        hot->csize = 0;
         --size;
 
         other.unlink_node(cold);                  // <-- FIX: use *other*
         other.table.erase(cold->vp_num);
+        other.used_bytes -= cold->csize;
+        cold->csize = 0;
         --other.size;
 
         // --- splice into the opposite lists ---
         other.insert_mru_node(hot);               // hot → unclist (MRU)
         insert_lru_node(cold);                    // cold → clist  (LRU)
+        return cold;
     }
 
 
@@ -327,9 +474,38 @@ private:
     // -----------------------------------------------------------------------
     // Convert full virtual address to virtual page number (vp_num).
     // -----------------------------------------------------------------------
-    static uint64_t addr_to_num(uint64_t vp_addr)
+    uint64_t addr_to_num(uint64_t vp_addr) const
     {
-        return vp_addr >> 12;  // divide by 4096
+        return vp_addr >> shift;  // divide by the page size
+    }
+
+    // -----------------------------------------------------------------------
+    // Enter a node whose page is not in the table yet. Once the insert is
+    // inlined, GCC cannot see through the stateful arena allocator that
+    // libc++ always sets the bucket hash before indexing the bucket list.
+    // -----------------------------------------------------------------------
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    void index_node(hash_node *n)
+    {
+        table.emplace(n->vp_num, n);
+    }
+#pragma GCC diagnostic pop
+
+    // -----------------------------------------------------------------------
+    // Node storage: the arena when there is one, the heap otherwise.
+    // -----------------------------------------------------------------------
+    hash_node* alloc_node(uint64_t vp_num)
+    {
+        if (!arena) return new hash_node(vp_num);
+        return new (arena->allocate(sizeof(hash_node))) hash_node(vp_num);
+    }
+
+    void free_node(hash_node *n)
+    {
+        if (!arena) { delete n; return; }
+        n->~hash_node();
+        arena->deallocate(n, sizeof(hash_node));
     }
 
     // -----------------------------------------------------------------------
@@ -344,6 +520,11 @@ private:
         else         tail = n->prev;
     }
 
+    void notify_evict(const hash_node *n)
+    {
+        if (evict_cb) evict_cb(*n, evict_ctx);
+    }
+
     // -----------------------------------------------------------------------
     // Insert node `n` at the head (MRU position) of the LRU list.
     // -----------------------------------------------------------------------
@@ -359,13 +540,25 @@ private:
     // -----------------------------------------------------------------------
     // Data members
     // -----------------------------------------------------------------------
+    // Upper bound on buckets pre-allocated at construction, so very large
+    // page capacities (e.g. derived from a byte budget) don't over-reserve.
+    static constexpr uint32_t RESERVE_MAX = 1u << 22;
+
+    uint32_t shift;  // log2 of the page size
     uint32_t cap;    // maximum number of distinct pages allowed
     uint32_t size;   // current number of pages
     hash_node *head; // MRU (most recent)
     hash_node *tail; // LRU (least recent)
+    uint64_t cap_bytes;  // byte budget (0 = pages only)
+    uint64_t used_bytes; // sum of csize over all nodes
+    SHMARENA::Arena *arena;  // node/table storage, nullptr = heap
+    evict_fn evict_cb = nullptr;  // on_evict()
+    void    *evict_ctx = nullptr;
 
     // Hash map: vp_num → pointer to the node in the LRU list
-    std::unordered_map<uint64_t, hash_node*> table;
+    using TableAlloc = SHMARENA::ArenaAllocator<std::pair<const uint64_t, hash_node*>>;
+    std::unordered_map<uint64_t, hash_node*, std::hash<uint64_t>,
+                       std::equal_to<uint64_t>, TableAlloc> table;
 };
 
 } // namespace HASHLL
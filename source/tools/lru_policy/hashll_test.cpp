@@ -4,6 +4,10 @@
 #include <iostream>
 #include "hashll.h"
 #include <assert.h>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
 // -----------------------------------------------------------------------
 // Testing checklist:
 // Same bucket nodes        o
@@ -13,6 +17,13 @@
 // Removing                 o
 // Searching                o
 // Marking as recent        o
+// Byte budget eviction     o
+// Configurable page size   o
+// Resize (shrink)          o
+// Range removal            o
+// Eviction callback        o
+// Shared arena across fork o
+// Sharers move with a swap  o
 // -----------------------------------------------------------------------
 
 void initialize_test_structure(HASHLL::HashLL &samebucket, HASHLL::HashLL &diffbucket)
@@ -31,6 +42,128 @@ void initialize_test_structure(HASHLL::HashLL &samebucket, HASHLL::HashLL &diffb
 
 
 
+void test_byte_budget()
+{
+    HASHLL::HashLL bl(100);
+    bl.set_byte_cap(1000);
+    for (int i = 1; i <= 4; i++)
+    {
+        bl.touch(i * 4096);
+        bl.set_csize(i * 4096, 300);   // 4th page pushes the budget over
+    }
+    assert(bl.get_size() == 3);
+    assert(bl.get_used_bytes() == 900);
+    assert(bl.find_node(1 * 4096) == nullptr);  // LRU went first
+    assert(bl.isFull() == false);
+
+    bl.remove(4 * 4096);
+    assert(bl.get_used_bytes() == 600);
+    std::cout << "byte budget ok" << std::endl;
+}
+
+static void record_evict(const HASHLL::HashLL::hash_node &n, void *ctx)
+{
+    static_cast<std::vector<uint64_t>*>(ctx)->push_back(n.vp_num);
+}
+
+void test_evict_hook()
+{
+    std::vector<uint64_t> out;
+    HASHLL::HashLL el(2);
+    el.on_evict(record_evict, &out);
+    el.touch(1 * 4096);
+    el.touch(2 * 4096);
+    el.touch(3 * 4096);                     // page cap
+    assert(out.size() == 1 && out[0] == 1);
+    el.remove(2 * 4096);                    // removal is not eviction
+    assert(out.size() == 1);
+    el.touch(4 * 4096);
+    el.set_byte_cap(100);
+    el.set_csize(4 * 4096, 80);
+    el.set_csize(3 * 4096, 80);             // byte budget
+    assert(out.size() == 2 && out[1] == 4);
+    el.touch(5 * 4096);
+    el.resize(1);                           // shrink
+    assert(out.size() == 3 && out[2] == 3);
+    std::cout << "evict hook ok" << std::endl;
+}
+
+void test_page_shift()
+{
+    HASHLL::HashLL huge(10, 21);            // 2 MiB pages
+    huge.touch(0x200000);
+    huge.touch(0x3ff000);                   // same 2 MiB page
+    huge.touch(0x400000);
+    assert(huge.get_size() == 2);
+    assert(huge.find_node(0x201000)->access_count == 2);
+    std::cout << "page shift ok" << std::endl;
+}
+
+void test_resize()
+{
+    HASHLL::HashLL rl(10);
+    for (int i = 1; i <= 10; i++) rl.touch(i * 4096);
+    assert(rl.resize(4) == 6);
+    assert(rl.get_size() == 4 && rl.get_cap() == 4);
+    assert(rl.lru_node()->vp_num == 7);     // oldest survivor
+    rl.resize(8);
+    rl.touch(11 * 4096);
+    assert(rl.get_size() == 5);
+    std::cout << "resize ok" << std::endl;
+}
+
+void test_remove_range()
+{
+    HASHLL::HashLL rr(100);
+    for (int i = 0; i < 50; i++) rr.touch(i * 4096);
+    assert(rr.remove_range(10 * 4096, 20 * 4096) == 10);      // per-page probes
+    assert(rr.get_size() == 40 && !rr.find_node(15 * 4096));
+    assert(rr.remove_range(45 * 4096 + 100, 1ULL << 40) == 5);  // list walk, partial first page
+    assert(rr.get_size() == 35 && rr.find_node(44 * 4096));
+    assert(rr.remove_range(0, 0) == 0);
+    rr.touch(200 * 4096);
+    assert(rr.hottest_node() != nullptr && rr.get_size() == 36);
+    std::cout << "remove range ok" << std::endl;
+}
+
+void test_shared_arena()
+{
+    std::string name = "hashll_test." + std::to_string(getpid());
+    SHMARENA::Arena *a = SHMARENA::Arena::create(name.c_str(), 1 << 20, 0);
+    assert(a);
+    HASHLL::HashLL *sl = new (a->allocate(sizeof(HASHLL::HashLL))) HASHLL::HashLL(4, 12, a);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        for (int i = 1; i <= 6; i++) sl->touch(i * 4096);   // evicts 1, 2
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    assert(sl->get_size() == 4);
+    assert(sl->find_node(6 * 4096) && !sl->find_node(2 * 4096));
+
+    SHMARENA::Arena *b = SHMARENA::Arena::attach(name.c_str());
+    assert(b == nullptr);                  // same address already mapped here
+    SHMARENA::Arena::detach(a, name.c_str());
+    std::cout << "shared arena ok" << std::endl;
+}
+
+void test_swap_sharers()
+{
+    HASHLL::HashLL cl(4), ul(4);
+    for (int i = 1; i <= 4; i++) ul.touch(i * 4096);
+    cl.touch(9 * 4096);
+    cl.touch(9 * 4096);
+    cl.find_node(9 * 4096)->sharers = 0x5;
+    ul.find_node(1 * 4096)->sharers = 0x2;
+    assert(ul.find_node(2 * 4096)->sharers == 0);
+    HASHLL::HashLL::hash_node *cold = cl.swap_with(ul);
+    assert(cold && cold->vp_num == 1 && cold->sharers == 0x2);
+    assert(ul.find_node(9 * 4096)->sharers == 0x5);
+    std::cout << "swap sharers ok" << std::endl;
+}
+
 // -----------------------------------------------------------------------
 // Execute tests
 // -----------------------------------------------------------------------
@@ -57,5 +190,13 @@ int main()
     }
     std::cout << "dbcap " << diffbucket.get_cap() << " dbsize " << diffbucket.get_size();
     std::cout << std::endl;
+
+    test_byte_budget();
+    test_evict_hook();
+    test_page_shift();
+    test_resize();
+    test_remove_range();
+    test_shared_arena();
+    test_swap_sharers();
     return 0;
 }
\ No newline at end of file
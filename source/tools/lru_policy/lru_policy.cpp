@@ -12,7 +12,27 @@
 #include <functional>
 #include <limits>
 #include <string>
+#include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <sys/syscall.h>
+#include <sched.h>
 #include "hashll.h"
+#include "pagecomp.h"
+#include "procfs.h"
+#include "shmarena.h"
+#include "ckpt.h"
+#include "tlbsim.h"
+#include "coherence.h"
+#include "prefetch.h"
+#include "tierpolicy.h"
+#include "swapdev.h"
+#include "shadow.h"
+#include "tinylfu.h"
+#include "refbits.h"
+#include "damon.h"
+#include "memregions.h"
+#include "follow_child.H"
 
 using namespace HASHLL;
 
@@ -27,6 +47,62 @@ KNOB<UINT64> KnobL2Size   	(KNOB_MODE_WRITEONCE, "pintool", "l2size",  "262144",
                             "L2 size (bytes)");
 KNOB<UINT32> KnobL2Assoc  	(KNOB_MODE_WRITEONCE, "pintool", "l2assoc", "8",
                             "L2 associativity");
+KNOB<BOOL>   KnobL2Shared 	(KNOB_MODE_WRITEONCE, "pintool", "l2shared", "1",
+                            "One L2 for all threads (0: one per thread)");
+KNOB<std::string> KnobL2Incl(KNOB_MODE_WRITEONCE, "pintool", "l2incl",  "nine",
+                            "L2 inclusion of L1: nine, inclusive or exclusive");
+KNOB<UINT64> KnobL3Size   	(KNOB_MODE_WRITEONCE, "pintool", "l3size",  "0",
+                            "L3 (last-level) size in bytes (0: no L3)");
+KNOB<UINT32> KnobL3Assoc  	(KNOB_MODE_WRITEONCE, "pintool", "l3assoc", "16",
+                            "L3 associativity");
+KNOB<BOOL>   KnobL3Shared 	(KNOB_MODE_WRITEONCE, "pintool", "l3shared", "1",
+                            "One L3 for all threads (0: one per thread)");
+KNOB<std::string> KnobL3Incl(KNOB_MODE_WRITEONCE, "pintool", "l3incl",  "inclusive",
+                            "L3 inclusion of L1/L2: nine, inclusive or exclusive");
+KNOB<std::string> KnobPfL1	(KNOB_MODE_WRITEONCE, "pintool", "pf_l1",   "none",
+                            "L1D prefetcher: none, next, stride or stream");
+KNOB<std::string> KnobPfL2	(KNOB_MODE_WRITEONCE, "pintool", "pf_l2",   "none",
+                            "L2 prefetcher: none, next, stride or stream");
+KNOB<UINT32> KnobPfDegree 	(KNOB_MODE_WRITEONCE, "pintool", "pf_degree", "2",
+                            "Lines prefetched per trigger (at most 16)");
+KNOB<UINT32> KnobPfDistance	(KNOB_MODE_WRITEONCE, "pintool", "pf_distance", "1",
+                            "Steps ahead of the trigger the first prefetch goes");
+KNOB<UINT32> KnobPfDelay  	(KNOB_MODE_WRITEONCE, "pintool", "pf_delay", "4",
+                            "Demand accesses to a cache before its prefetches land");
+KNOB<UINT32> KnobCores   	(KNOB_MODE_WRITEONCE, "pintool", "cores",   "0",
+                            "Private caches belong to N simulated cores (0: one set per thread)");
+KNOB<std::string> KnobSched	(KNOB_MODE_WRITEONCE, "pintool", "sched",   "static",
+                            "Thread-to-core mapping with -cores: static, rr or affinity");
+KNOB<UINT64> KnobResched  	(KNOB_MODE_WRITEONCE, "pintool", "resched", "1000000",
+                            "With -sched affinity, re-read the CPU every N instructions per thread (0: at start only)");
+KNOB<std::string> KnobCoherence(KNOB_MODE_WRITEONCE, "pintool", "coherence", "none",
+                            "Keep private caches coherent: none, mesi or moesi");
+KNOB<UINT32> KnobTopShare	(KNOB_MODE_WRITEONCE, "pintool", "topshare", "10",
+                            "Lines and PCs listed by coherence misses with -coherence");
+KNOB<BOOL>   KnobIFetch   	(KNOB_MODE_WRITEONCE, "pintool", "ifetch",  "0",
+                            "Model instruction fetches (per basic block) through L1I");
+KNOB<UINT64> KnobL1ISize  	(KNOB_MODE_WRITEONCE, "pintool", "l1isize", "32768",
+                            "L1I size (bytes)");
+KNOB<UINT32> KnobL1IAssoc 	(KNOB_MODE_WRITEONCE, "pintool", "l1iassoc", "8",
+                            "L1I associativity");
+KNOB<BOOL>   KnobTlb      	(KNOB_MODE_WRITEONCE, "pintool", "tlb",     "0",
+                            "Model TLBs and page walks");
+KNOB<UINT32> KnobDTlbEntries(KNOB_MODE_WRITEONCE, "pintool", "dtlb_entries", "64",
+                            "L1 dTLB entries (per thread)");
+KNOB<UINT32> KnobDTlbAssoc	(KNOB_MODE_WRITEONCE, "pintool", "dtlb_assoc", "4",
+                            "L1 dTLB associativity");
+KNOB<UINT32> KnobITlbEntries(KNOB_MODE_WRITEONCE, "pintool", "itlb_entries", "128",
+                            "L1 iTLB entries (per thread, used with -ifetch)");
+KNOB<UINT32> KnobITlbAssoc	(KNOB_MODE_WRITEONCE, "pintool", "itlb_assoc", "8",
+                            "L1 iTLB associativity");
+KNOB<UINT32> KnobSTlbEntries(KNOB_MODE_WRITEONCE, "pintool", "stlb_entries", "1536",
+                            "Shared L2 TLB entries");
+KNOB<UINT32> KnobSTlbAssoc	(KNOB_MODE_WRITEONCE, "pintool", "stlb_assoc", "12",
+                            "Shared L2 TLB associativity");
+KNOB<UINT32> KnobPwcEntries	(KNOB_MODE_WRITEONCE, "pintool", "pwc_entries", "32",
+                            "Page-walk cache entries (per thread, upper levels)");
+KNOB<UINT32> KnobPwcAssoc	(KNOB_MODE_WRITEONCE, "pintool", "pwc_assoc", "4",
+                            "Page-walk cache associativity");
 KNOB<UINT32> KnobBlkBytes 	(KNOB_MODE_WRITEONCE, "pintool", "blk",     "64",
                             "Cache-line size");
 KNOB<UINT32> KnobUncompressedListSize 
@@ -44,6 +120,117 @@ KNOB<UINT32> KnobPromoteCompressedFrequency
 KNOB<UINT32> KnobExpansionFrequency
 							(KNOB_MODE_WRITEONCE, "pintool", "exfreq",  "65536" ,
 							"Expansion frequency for promoting compressed page to uncompressed");
+KNOB<std::string> KnobPolicy
+							(KNOB_MODE_WRITEONCE, "pintool", "policy",  "promote" ,
+							"Page-tier scheme: promote (built-in, both tiers), or an uncompressed-tier policy over an LRU clist: clock, clockpro, 2q, arc, lirs, mglru");
+KNOB<BOOL>   KnobCompressModel
+							(KNOB_MODE_WRITEONCE, "pintool", "cmodel",  "0" ,
+							"Size compressed list in bytes from sampled page contents");
+KNOB<UINT64> KnobCompressedListBytes
+							(KNOB_MODE_WRITEONCE, "pintool", "clbytes", "0" ,
+							"Byte budget of compressed list with -cmodel (0: clsize pages)");
+KNOB<std::string> KnobCompressEstimator
+							(KNOB_MODE_WRITEONCE, "pintool", "cest",    "best" ,
+							"Compressed size estimator with -cmodel: best, bdi, lz");
+KNOB<BOOL>   KnobSwap
+							(KNOB_MODE_WRITEONCE, "pintool", "swap",    "0" ,
+							"Write pages evicted from clist to a swap device (zswap writeback)");
+KNOB<UINT64> KnobSwapPages
+							(KNOB_MODE_WRITEONCE, "pintool", "swap_pages", "0" ,
+							"Swap capacity in pages with -swap (0: unbounded)");
+KNOB<FLT64>  KnobSwapBw		(KNOB_MODE_WRITEONCE, "pintool", "swap_bw",  "1.0" ,
+							"Swap bandwidth in bytes per -lat_unit (0: unlimited)");
+KNOB<UINT32> KnobShadow		(KNOB_MODE_WRITEONCE, "pintool", "shadow",   "0" ,
+							"Shadow entries per page tier for refault distances (0: off)");
+KNOB<BOOL>   KnobTinyLfu	(KNOB_MODE_WRITEONCE, "pintool", "tinylfu",  "0" ,
+							"TinyLFU admission for clist inserts and promotions into unclist");
+KNOB<UINT32> KnobPagevec	(KNOB_MODE_WRITEONCE, "pintool", "pagevec",  "0" ,
+							"Batch page-tier accesses per thread, up to this many (0: off, max 64)");
+KNOB<UINT64> KnobPagevecIns	(KNOB_MODE_WRITEONCE, "pintool", "pagevec_ins", "100000" ,
+							"Flush a thread's batch once its oldest entry is this many of the thread's instructions old (0: only when full)");
+KNOB<UINT64> KnobScan	(KNOB_MODE_WRITEONCE, "pintool", "scan",  "0" ,
+							"Accessed-bit mode: unclist hits only set a bit; a scanner ages unclist every this many instructions (0: off)");
+KNOB<UINT32> KnobPcStats	(KNOB_MODE_WRITEONCE, "pintool", "pcstats",  "0" ,
+							"Report the top this many functions and source lines by clist hits, cpage accesses and promotions (0: off)");
+KNOB<UINT32> KnobAllocSites	(KNOB_MODE_WRITEONCE, "pintool", "allocsites",  "0" ,
+							"Track malloc/calloc/realloc/free/mmap/munmap and report the top this many allocation sites by bytes outside unclist (0: off)");
+KNOB<UINT64> KnobDamon	(KNOB_MODE_WRITEONCE, "pintool", "damon",  "0" ,
+							"DAMON-style region monitoring: sample one page per region every this many instructions and place whole regions in tiers (0: off)");
+KNOB<UINT32> KnobDamonAggr	(KNOB_MODE_WRITEONCE, "pintool", "damon_aggr",  "20" ,
+							"Samples per DAMON aggregation (and tier placement)");
+KNOB<UINT32> KnobDamonMin	(KNOB_MODE_WRITEONCE, "pintool", "damon_min",  "10" ,
+							"Minimum number of DAMON regions");
+KNOB<UINT32> KnobDamonMax	(KNOB_MODE_WRITEONCE, "pintool", "damon_max",  "1000" ,
+							"Maximum number of DAMON regions");
+KNOB<UINT32> KnobDamonUpdate	(KNOB_MODE_WRITEONCE, "pintool", "damon_update",  "10" ,
+							"Aggregations between re-reading the mappings DAMON monitors");
+KNOB<BOOL>   KnobRegions	(KNOB_MODE_WRITEONCE, "pintool", "regions",  "0" ,
+							"Break page-tier accesses and occupancy down by memory region (heap, stack, anon, file, code)");
+KNOB<UINT32> KnobRegionsPeriod(KNOB_MODE_WRITEONCE, "pintool", "regions_ms", "1000" ,
+							"Period (ms) for re-reading the mappings -regions classifies");
+KNOB<std::string> KnobFilePages(KNOB_MODE_WRITEONCE, "pintool", "filepages", "tier" ,
+							"File-backed and code pages: tier (like any page) | skip (page cache, kept out of the tiers; implies -regions)");
+KNOB<BOOL>   KnobSharers	(KNOB_MODE_WRITEONCE, "pintool", "sharers",  "0" ,
+							"Track the threads that access each listed page; report private vs shared occupancy and accesses");
+KNOB<UINT32> KnobPrivTier	(KNOB_MODE_WRITEONCE, "pintool", "privtier",  "0" ,
+							"Also give every thread a private LRU tier of this many pages, for comparison (0: off)");
+KNOB<std::string> KnobLatUnit
+							(KNOB_MODE_WRITEONCE, "pintool", "lat_unit", "cycles" ,
+							"Unit of the -lat_* costs (label only)");
+KNOB<FLT64>  KnobLatL1		(KNOB_MODE_WRITEONCE, "pintool", "lat_l1",   "4" ,
+							"Cost of an L1 access");
+KNOB<FLT64>  KnobLatL2		(KNOB_MODE_WRITEONCE, "pintool", "lat_l2",   "14" ,
+							"Cost of an L2 access");
+KNOB<FLT64>  KnobLatL3		(KNOB_MODE_WRITEONCE, "pintool", "lat_l3",   "40" ,
+							"Cost of an L3 access");
+KNOB<FLT64>  KnobLatUncl	(KNOB_MODE_WRITEONCE, "pintool", "lat_uncl", "200" ,
+							"Cost of an unclist hit (plain memory access)");
+KNOB<FLT64>  KnobLatCl		(KNOB_MODE_WRITEONCE, "pintool", "lat_cl",   "2000" ,
+							"Cost of a clist hit (decompression)");
+KNOB<FLT64>  KnobLatCpage	(KNOB_MODE_WRITEONCE, "pintool", "lat_cpage","20000" ,
+							"Cost of a cpage access (fault, decompress, evict, recompress)");
+KNOB<FLT64>  KnobLatPromote	(KNOB_MODE_WRITEONCE, "pintool", "lat_promote", "4000" ,
+							"Cost of a clist->unclist promotion (swap_with)");
+KNOB<FLT64>  KnobLatSwap	(KNOB_MODE_WRITEONCE, "pintool", "lat_swap", "200000" ,
+							"Device latency of a swap-in (major fault), before queueing");
+KNOB<FLT64>  KnobLatRecompress
+							(KNOB_MODE_WRITEONCE, "pintool", "lat_recomp", "3000" ,
+							"Cost of recompressing a dirty page on demotion");
+KNOB<FLT64>  KnobBaseCPI	(KNOB_MODE_WRITEONCE, "pintool", "base_cpi", "1.0" ,
+							"Cost per instruction excluding memory, for slowdown");
+KNOB<UINT32> KnobTopWrites
+							(KNOB_MODE_WRITEONCE, "pintool", "topwrites", "10" ,
+							"Number of most-written pages to report");
+KNOB<UINT32> KnobPageSize	(KNOB_MODE_WRITEONCE, "pintool", "pagesize", "4096" ,
+							"Page size tracked by the page lists (bytes, power of two)");
+KNOB<BOOL>   KnobHugePages	(KNOB_MODE_WRITEONCE, "pintool", "thp",      "0" ,
+							"Mixed mode: track huge-page-backed ranges as single 2 MiB pages");
+KNOB<UINT32> KnobSmapsPeriod(KNOB_MODE_WRITEONCE, "pintool", "smaps_ms", "1000" ,
+							"How often -thp re-reads /proc/<pid>/smaps (ms)");
+KNOB<FLT64>  KnobUncompressedPct
+							(KNOB_MODE_WRITEONCE, "pintool", "unclpct",  "0" ,
+							"Size unclist as this % of the measured RSS (0: use -unclsize)");
+KNOB<FLT64>  KnobCompressedPct
+							(KNOB_MODE_WRITEONCE, "pintool", "clpct",    "0" ,
+							"Size clist as this % of the measured RSS (0: use -clsize)");
+KNOB<UINT32> KnobRssPeriod	(KNOB_MODE_WRITEONCE, "pintool", "rss_ms",   "1000" ,
+							"How often -unclpct/-clpct re-read /proc/<pid>/statm (ms)");
+KNOB<BOOL>   KnobFollowExecv(KNOB_MODE_WRITEONCE, "pintool", "follow_execv", "0" ,
+							"Follow fork/exec children; all processes share one set of page tiers");
+KNOB<UINT64> KnobShmMiB		(KNOB_MODE_WRITEONCE, "pintool", "shm_mb",   "0" ,
+							"Shared tier segment size in MiB (0: sized from the list capacities)");
+KNOB<std::string> KnobShmName
+							(KNOB_MODE_WRITEONCE, "pintool", "shm_name", "" ,
+							"Shared tier segment to attach to (passed to exec'd children)");
+KNOB<UINT64> KnobCheckpointAt
+							(KNOB_MODE_WRITEONCE, "pintool", "checkpoint_at", "0" ,
+							"Save the simulated state after this many instructions (0: never)");
+KNOB<std::string> KnobCheckpointFile
+							(KNOB_MODE_WRITEONCE, "pintool", "checkpoint_file", "lru.ckpt" ,
+							"Checkpoint written by -checkpoint_at");
+KNOB<std::string> KnobRestoreFrom
+							(KNOB_MODE_WRITEONCE, "pintool", "restore_from", "" ,
+							"Start from a checkpoint; instructions before it are only counted");
 KNOB<std::string> KnobOutfile
 							(KNOB_MODE_WRITEONCE, "pintool", "o",  "fini.out" ,
 							"Output location");
@@ -56,7 +243,12 @@ enum { access_data=0, access_inst=1, access_page_table=2 };
 
 #define CACHELINE_OFFSET           0
 #define DATA_BLOCK_FLOOR_ADDR_MASK ~(static_cast<UINT64>(KnobBlkBytes.Value()-1))
-#define PAGE_SIZE				   4096
+#define BASE_PAGE_SIZE			   4096
+#define HUGE_PAGE_SIZE			   (2ULL << 20)
+
+#ifndef MADV_FREE
+#define MADV_FREE				   8
+#endif
 
 const uint64_t MAXVAL = std::numeric_limits<uint64_t>::max();
 
@@ -73,6 +265,9 @@ std::ofstream Out; // output file
 HashLL * clist = nullptr;
 HashLL * unclist = nullptr;
 
+uint64_t page_size  = BASE_PAGE_SIZE;	// -pagesize
+uint32_t page_shift = 12;
+
 
 // -----------------------------------------------------------------------
 // Cache structures/simulation
@@ -87,7 +282,7 @@ struct SimpleCacheConfig {
     uint32_t setBits()   const { return 63 - __builtin_clzll(sets());    }
 };
 
-struct Line { uint64_t tag=0; uint32_t age=0; bool valid=false, dirty=false; };
+struct Line { uint64_t tag=0; uint32_t age=0; bool valid=false, dirty=false, pf=false; };
 
 inline void TouchLRU(std::vector<Line>& w, uint32_t hit)
 { uint32_t a=w[hit].age; for(auto& l:w) if(l.valid&&l.age<a) ++l.age; w[hit].age=0; }
@@ -108,54 +303,100 @@ public:
         : cfg(c), mask(cfg.sets()-1),
           sets(cfg.sets(), std::vector<Line>(cfg.ways)) {}
 
-    template<typename Upper, typename WB>
-    bool Access(uint64_t addr, bool isWrite, Upper up, WB wb)
+    // Look a line up; a hit becomes MRU, and dirty on a write. The first
+    // hit on a prefetched line makes the prefetch useful.
+    bool Lookup(uint64_t addr, bool isWrite, bool* firstUse = nullptr)
     {
         ++acc;
         auto [set,tag] = Decode(addr);
         auto& w = sets[set];
-
-        // lookup
         for(uint32_t i=0;i<w.size();++i)
             if(w[i].valid && w[i].tag == tag){
                 TouchLRU(w,i);
                 if(isWrite) w[i].dirty = true;
-                return true;                     // hit
+                if(w[i].pf){ w[i].pf = false; ++pfUseful; if(firstUse) *firstUse = true; }
+                return true;
             }
-
         ++miss;
-        uint32_t v = PickVictim(w); Line ev = w[v];
+        return false;
+    }
 
-        // handle eviction
-        if(ev.valid){
-            if constexpr(!std::is_same_v<Upper,std::nullptr_t>)
-                up(Reconstruct(set, ev.tag), ev.dirty);
-            if constexpr(!std::is_same_v<WB,std::nullptr_t>)
-                if(ev.dirty) wb(Reconstruct(set, ev.tag));
-        }
+    // Install a line as MRU and hand back whatever it displaced. A line
+    // that is already present is only refreshed (and its dirty bit merged).
+    struct Victim { bool valid; uint64_t addr; bool dirty; };
+    Victim Fill(uint64_t addr, bool dirty, bool prefetch = false)
+    {
+        auto [set,tag] = Decode(addr);
+        auto& w = sets[set];
+        for(uint32_t i=0;i<w.size();++i)
+            if(w[i].valid && w[i].tag == tag){
+                TouchLRU(w,i);
+                w[i].dirty |= dirty;
+                return { false, 0, false };
+            }
 
+        uint32_t v = PickVictim(w); Line ev = w[v];
+        if(ev.valid && ev.pf) ++pfUseless;
         for(auto& l : w) if(l.valid) ++l.age;    // age others
-        w[v] = { tag, 0, true, isWrite };
-        return false;                            // miss
+        w[v] = { tag, 0, true, dirty, prefetch };
+        return { ev.valid, ev.valid ? Reconstruct(set, ev.tag) : 0, ev.valid && ev.dirty };
     }
 
-    void Install(uint64_t addr, bool dirty)
+    // Drop a line if present (back-invalidation, exclusive hand-up).
+    bool Invalidate(uint64_t addr, bool& dirty)
     {
         auto [set,tag] = Decode(addr);
-        auto& w = sets[set];
-        uint32_t v = PickVictim(w); Line ev = w[v];
+        for(auto& l : sets[set])
+            if(l.valid && l.tag == tag){
+                dirty = l.dirty;
+                if(l.pf) ++pfUseless;
+                l.valid = l.dirty = l.pf = false;
+                return true;
+            }
+        dirty = false;
+        return false;
+    }
+
+    // Presence check that leaves LRU order and stats alone.
+    bool Contains(uint64_t addr) const
+    {
+        auto [set,tag] = Decode(addr);
+        for(auto& l : sets[set])
+            if(l.valid && l.tag == tag) return true;
+        return false;
+    }
 
-        if(ev.valid && ev.dirty && wbInstall)
-            wbInstall(Reconstruct(set, ev.tag));
+    // Clear a line's dirty bit (coherence downgrade); true if it was dirty.
+    bool Clean(uint64_t addr)
+    {
+        auto [set,tag] = Decode(addr);
+        for(auto& l : sets[set])
+            if(l.valid && l.tag == tag){ bool d = l.dirty; l.dirty = false; return d; }
+        return false;
+    }
 
-        for(auto& l : w) if(l.valid) ++l.age;
-        w[v] = { tag, 0, true, dirty };
+    // Absorb a dirty write-back from above; false if the line isn't here.
+    bool MarkDirty(uint64_t addr)
+    {
+        auto [set,tag] = Decode(addr);
+        for(auto& l : sets[set])
+            if(l.valid && l.tag == tag){ l.dirty = true; return true; }
+        return false;
     }
 
-    void SetWBInstall(std::function<void(uint64_t)> f) { wbInstall = std::move(f); }
     uint64_t Accesses() const { return acc; }
     uint64_t Misses()   const { return miss; }
-	void ResetStats()	{ acc = 0; miss = 0; }
+    uint64_t PfUseful() const { return pfUseful; }
+    uint64_t PfUseless() const { return pfUseless; }
+	void ResetStats()	{ acc = 0; miss = 0; pfUseful = 0; pfUseless = 0; }
+
+	// Checkpoint support: every line, set by set, way by way.
+	size_t LineCount() const { return sets.size() * cfg.ways; }
+	void Export(std::vector<Line>& out) const
+	{ for (auto& w : sets) out.insert(out.end(), w.begin(), w.end()); }
+	void Import(const Line* in)
+	{ for (auto& w : sets) { std::copy(in, in + w.size(), w.begin()); in += w.size(); } }
+	void SetStats(uint64_t a, uint64_t m) { acc = a; miss = m; }
 
 private:
     std::pair<uint32_t,uint64_t> Decode(uint64_t a) const
@@ -170,7 +411,21 @@ private:
     uint32_t mask;
     std::vector<std::vector<Line>> sets;
     uint64_t acc = 0, miss = 0;
-    std::function<void(uint64_t)> wbInstall;
+    uint64_t pfUseful = 0, pfUseless = 0;	// prefetched lines used / evicted unused
+};
+
+// -----------------------------------------------------------------------
+// Page tier lock: a PIN_LOCK, or a spin lock inside the shared segment
+// when the tiers are shared with other processes (-follow_execv).
+// -----------------------------------------------------------------------
+struct TierLock
+{
+	PIN_LOCK            local;
+	SHMARENA::SpinLock* shared = nullptr;
+
+	void Init()				{ PIN_InitLock(&local); }
+	void Get(THREADID tid)	{ if (shared) shared->lock(); else PIN_GetLock(&local, tid+1); }
+	void Release()			{ if (shared) shared->unlock(); else PIN_ReleaseLock(&local); }
 };
 
 // -----------------------------------------------------------------------
@@ -178,28 +433,353 @@ private:
 // -----------------------------------------------------------------------
 
 // Pin and cache simulation
-PIN_LOCK              l2Lock;
 PIN_LOCK			  reset_lock;
-PIN_LOCK			  unc_lock;
-PIN_LOCK   			  c_lock;
+TierLock			  unc_lock;
+TierLock   			  c_lock;
 PIN_LOCK              cpage_lock;
-SimpleCacheConfig     cfgL1, cfgL2;
-SimpleCache*          L2 = nullptr;          // created in main()
-std::vector<SimpleCache*> L1;                // per thread
+PIN_LOCK              est_lock;
+
+// Cache hierarchy: levels[0] is L1D, then L2 and an optional L3; fetches
+// use l1i in place of levels[0]. A level is one shared cache or one per
+// thread, each with its own lock, and none is held while another level is
+// touched. Inclusion is relative to the levels above: NINE, inclusive
+// (evictions back-invalidate above) or exclusive (a victim cache, filled
+// only by lines evicted from above). The page tiers see last-level misses.
+enum Inclusion : uint8_t { INCL_NINE = 0, INCL_INCLUSIVE, INCL_EXCLUSIVE };
+constexpr size_t MAX_LEVELS = 3;
+
+struct CacheUnit {
+	SimpleCache           cache;
+	PREFETCH::Prefetcher  pf;
+	PIN_LOCK              lock;
+	CacheUnit(const SimpleCacheConfig& c, const PREFETCH::Config& p)
+		: cache(c), pf(p) { PIN_InitLock(&lock); }
+};
+
+struct CacheLevel {
+	const char*              name = "";
+	SimpleCacheConfig        cfg  = {};
+	bool                     shared = false;
+	Inclusion                incl = INCL_NINE;
+	PREFETCH::Config         pf;
+	std::vector<CacheUnit*>  units;			// [0] if shared, else by tid
+	std::vector<CacheUnit*>  exited;		// unpublished units, freed in Fini
+	uint64_t                 retiredAcc = 0, retiredMiss = 0;	// exited threads
+	uint64_t                 retiredPf[5] = {};	// issued, useful, late, useless, dropped
+};
+std::vector<CacheLevel> levels;
+CacheLevel              l1i;
+std::atomic<uint64_t>   back_invalidations{0};
+std::atomic<uint64_t>   pf_memory[MAX_LEVELS];	// prefetches that went to the page tiers
+std::atomic<size_t>     unitSpan{0};			// highest private unit + 1
+
+// Cores (-cores N): private caches are indexed by a slot, which is the
+// thread id, or with -cores the core the scheduler put the thread on:
+// static (tid mod N), rr (start order) or affinity (sched_getcpu() mod N,
+// re-read every -resched instructions, so threads can migrate). Core
+// caches live for the whole run.
+enum CoreSched : uint8_t { CORE_STATIC, CORE_RR, CORE_AFFINITY };
+uint32_t  cores = 0;
+CoreSched sched = CORE_STATIC;
+struct CoreMap { uint32_t core = 0; uint64_t resample = 0; };
+std::vector<CoreMap> coreMap;				// by tid, PIN_MAX_THREADS
+std::atomic<uint32_t> rrNext{0};
+std::atomic<uint64_t> migrations{0};
+std::atomic<uint64_t> threads_started{0};
+
+static inline uint32_t Slot(THREADID tid) { return cores ? coreMap[tid].core : tid; }
+
+// Coherence (-coherence): a MESI/MOESI directory over the private caches,
+// sharded by line address. Only data accesses take part. A write drops the
+// other threads' copies; a later miss on such a copy is a coherence miss,
+// and false sharing if it touches none of the bytes written since. Each
+// shard also keeps the per-line and per-PC counts for the report.
+bool coherence = false;
+struct CohCount { uint64_t inval = 0, miss = 0, false_miss = 0; };
+struct DirShard {
+	PIN_LOCK lock;
+	COH::Directory dir;
+	std::unordered_map<uint64_t, CohCount> byLine, byPC;
+	DirShard() { PIN_InitLock(&lock); }
+};
+constexpr size_t DIR_SHARDS = 64;
+DirShard* dirShards = nullptr;				// created in main() with -coherence
+std::atomic<uint64_t> coh_upgrades{0};		// writes that had to invalidate
+std::atomic<uint64_t> coh_invalidations{0};	// private copies dropped
+std::atomic<uint64_t> coh_downgrades{0};	// E/M lines read by another thread
+std::atomic<uint64_t> coh_writebacks{0};	// ... whose dirty data went down (MESI)
+std::atomic<uint64_t> coh_misses{0};
+std::atomic<uint64_t> coh_false{0};
+
+// Instruction fetch (-ifetch): one call per basic block walks its lines
+// through L1I. Pages that supplied instructions are tagged as code, and
+// their tier outcomes are counted apart.
+bool     ifetch = false;
+uint64_t code_unclist_access	= 0;
+uint64_t code_clist_access		= 0;
+uint64_t code_cpage_access		= 0;
 
 // LRU list access counters and frequency vars
 uint64_t clist_access   = 0;
 uint64_t unclist_access = 0;
 uint64_t cpage_access	= 0;
+uint64_t promotions		= 0;
+
+// Swap tier (-swap): pages clist evicts are written back to a device, and
+// touching one again is a major fault instead of a cpage access.
+SWAPDEV::Device* swapdev = nullptr;
+PIN_LOCK         swap_lock;
+
+// Refault distances (-shadow): each tier keeps shadow entries for the
+// pages it evicted, and a page coming back reports how long it was gone.
+enum { TIER_UNCL = 0, TIER_CL = 1, TIER_CPAGE = 2 };	// shadows: the first two
+SHADOW::Table* shadows[2] = { nullptr, nullptr };
+PIN_LOCK       shadow_lock;
+
+// TinyLFU admission (-tinylfu): a frequency sketch over every page that
+// reaches the tiers decides whether a new page may displace clist's LRU,
+// and whether the hottest clist page may displace unclist's.
+TINYLFU::Sketch* lfu = nullptr;
+PIN_LOCK         lfu_lock;
+uint64_t lfu_rejects			= 0;	// clist inserts refused
+uint64_t lfu_promote_rejects	= 0;	// promotions refused
+
+// Per-thread pagevecs (-pagevec): page-tier accesses wait in a small
+// per-thread buffer and are applied in bulk. See PagevecFlush.
+constexpr uint32_t MAX_PAGEVEC = 64;
+struct Pagevec {
+	struct Entry { uint64_t vp_addr, pc; bool write, code; };
+	Entry    e[MAX_PAGEVEC];
+	uint32_t n = 0;
+	uint64_t first = 0;		// the thread's instruction count at the oldest entry
+	THREADID owner = 0;
+};
+uint32_t pagevecSize = 0;
+uint64_t pagevecIns  = 0;
+std::vector<Pagevec*> pagevecs;		// by tid
+uint64_t pagevec_flushes = 0;
+uint64_t pagevec_batched = 0;		// accesses applied under the batch locks
+
+// -----------------------------------------------------------------------
+// Page-tier schemes (-policy). A scheme decides what a page-tier access
+// does to both tiers: residency, promotion, demotion and the tier
+// counters. TierAccess makes one call into it; the rest of the tool
+// reaches it through the hooks below. PromoteScheme is the built-in
+// promote (steps 0-5 in PromoteScheme::access); ResidentScheme runs a
+// TIERPOLICY::PageTierPolicy over the uncompressed tier, with clist as the
+// LRU pool of its victims.
+// -----------------------------------------------------------------------
+class TierScheme
+{
+public:
+	virtual ~TierScheme() {}
+	virtual const char* name() const = 0;
+
+	// One page-tier access; vp_addr is page aligned. Takes the tier locks.
+	virtual void access(THREADID tid, bool code, uint64_t vp_addr, uint64_t pc) = 0;
+
+	// -pagevec: apply the access if it only refreshes a page already
+	// listed; false if it needs access(). Caller holds unc_lock and c_lock.
+	virtual bool apply_listed(THREADID tid, const Pagevec::Entry& e) = 0;
+
+	// -unclpct: unclist's new capacity. Returns the pages evicted. Caller
+	// holds unc_lock.
+	virtual uint32_t resize_unclist(uint32_t pages) { return unclist->resize(pages); }
+
+	// Page numbers [lo, hi) were unmapped. Caller holds unc_lock.
+	virtual void release(uint64_t lo, uint64_t hi) { (void)lo; (void)hi; }
+
+	// unclist was just restored from a checkpoint.
+	virtual void restored() {}
+
+	// Appended to the report's "Page policy" line.
+	virtual void report(std::ostream& os) const { (void)os; }
+};
+TierScheme* tiers = nullptr;
+
+// Accessed-bit scanning (-scan). Pages in unclist are "mapped": an access
+// to one only sets its accessed bit (and dirty bit on a write), with no
+// lock. Everything else faults into the usual path. See ScanTiers.
+uint64_t scanEvery = 0;
+std::atomic<uint64_t> scanAt{0};	// next scan, in global instructions
+PIN_SEMAPHORE scanSem;
+REFBITS::Bitmap* mapped_bits = nullptr;		// under unc_lock
+REFBITS::Bitmap* accessed_bits = nullptr;
+REFBITS::Bitmap* dirty_bits = nullptr;
+uint64_t scans = 0, scan_pages = 0, scan_young = 0, scan_hits = 0;
+
+// DAMON-style monitoring (-damon). Page-tier accesses only set an accessed
+// bit and count against the tier their region is placed in; the monitor
+// and the placement run on a tool thread. See DamonThread.
+struct Placed { uint64_t lo, hi; int tier; };	// pages [lo, hi)
+uint64_t damonEvery = 0;
+std::atomic<uint64_t> damonAt{0};	// next sample, in global instructions
+PIN_SEMAPHORE    damonSem;
+DAMON::Monitor*  damon = nullptr;	// the tool thread's
+REFBITS::Bitmap* damon_bits = nullptr;
+std::vector<Placed> placement;		// sorted, under damonLock
+PIN_RWMUTEX      damonLock;
+uint64_t damon_promoted = 0, damon_demoted = 0;		// pages, under unc_lock
+
+// Memory regions (-regions). Every page-tier access is looked up in a map
+// of the application's mappings, kept current from image loads, mmap,
+// munmap and brk, and a periodic re-read of the maps file; see
+// RegionsThread. -filepages skip keeps file-backed pages out of the tiers.
+enum { RK_ALL, RK_CLIST, RK_CPAGE, RK_SKIPPED, RK_COUNTS };
+bool regionsOn = false;
+bool skipFilePages = false;
+MEMREGIONS::Map memRegions;			// under regionLock
+std::vector<uint64_t> threadStacks;	// stack pointers at thread start, under regionLock
+PIN_RWMUTEX regionLock;
+
+// Sharing (-sharers). Each listed page's node records the threads that
+// accessed it (bit tid % 32, so threads 32 apart alias) and every access
+// to a listed page counts as private or shared by the node's sharers after
+// it. A page that leaves both lists starts over; accesses -scan or -damon
+// take off the slow path leave sharers alone. -privtier runs a private LRU
+// per thread beside the shared tiers, fed the same accesses.
+bool sharersOn = false;
+std::atomic<uint64_t> share_acc[3][2] = {};	// tier x {private, shared}
+uint32_t privPages = 0;
+std::vector<HashLL*> privTiers;		// by tid, kept past ThreadFini
+
+// Per-PC attribution (-pcstats). Each thread counts, per instruction
+// address, the accesses it adds to clist_access, cpage_access and
+// promotions; tables of exited threads are merged into pcRetired. Counts
+// cover the whole run: interval resets leave them alone.
+enum { PC_CLIST, PC_CPAGE, PC_PROMOTE, PC_KINDS };
+struct PcCounts { uint64_t n[PC_KINDS] = {}; };
+typedef std::unordered_map<uint64_t, PcCounts> PcTable;
+uint32_t pcTop = 0;
+std::vector<PcTable*> pcTables;		// by tid
+PcTable  pcRetired;
+PIN_LOCK pc_lock;
+
+// Allocation sites (-allocsites). The allocator entry points are wrapped
+// (ImageLoad) and every live block is indexed by address, with the return
+// address of the outermost allocator call as its site. All under
+// alloc_lock.
+enum { AL_MALLOC, AL_CALLOC, AL_REALLOC, AL_FREE, AL_MMAP, AL_MUNMAP };
+struct AllocCall { uint32_t depth = 0, kind = 0; uint64_t site = 0, a0 = 0, a1 = 0; };
+struct Alloc     { uint64_t hi, site; };
+struct AllocSite { uint64_t allocs = 0, live = 0, live_bytes = 0, cpage = 0; };
+uint32_t allocTop = 0;
+std::vector<AllocCall*> allocCalls;		// by tid: the call in progress
+std::map<uint64_t, Alloc> allocs;		// by start address
+std::unordered_map<uint64_t, AllocSite> allocSites;
+PIN_LOCK alloc_lock;
+
+// Write tracking: dirty L2 write-backs mark pages, dirty pages cost a
+// recompression when demoted, and writes into clist are counted apart.
+uint64_t dirty_writebacks	= 0;
+uint64_t clist_writebacks	= 0;
+uint64_t recompressions		= 0;
 
 uint64_t clist_freq 	= 0;
 uint64_t unclist_freq	= 0;
 
+// Content-aware compressed tier (-cmodel). Estimates are cached per vp_num
+// while the page is in a tier, so pages are only sampled when they enter
+// clist. A tier write marks the node stale (PageWrite) and the next
+// charge samples it again; est_lock is never taken on the store path.
+// Pages leaving both tiers drop their estimate from the eviction
+// callbacks; shared tiers have none, so there the cache is cleared once
+// it holds est_bound entries.
+bool            cmodel    = false;
+PAGECOMP::Mode  cest_mode = PAGECOMP::MODE_BEST;
+std::unordered_map<uint64_t, PAGECOMP::Estimate> est_cache;
+uint64_t est_bound		= 0;		// 0: unbounded (private tiers)
+uint64_t est_computed	= 0;
+uint64_t est_reused		= 0;
+uint64_t est_kind[4]	= {0, 0, 0, 0};	// indexed by PAGECOMP::Kind
+uint64_t clist_byte_evictions = 0;
+
+// Mixed page sizes (-thp): 2 MiB-aligned ranges backed by huge pages,
+// sorted by start, rebuilt from smaps by an internal thread.
+bool mixedPages = false;
+PIN_RWMUTEX hugeLock;
+std::vector<std::pair<uint64_t, uint64_t>> hugeRanges;	// [start, end)
+std::atomic<uint64_t> huge_accesses{0};
+
+// RSS-relative sizing (-unclpct/-clpct). rss_base is the footprint of Pin,
+// the tool and the loaded image before the application starts running.
+double   unclpct = 0, clpct = 0;
+uint64_t rss_base		= 0;	// bytes
+uint64_t rss_app		= 0;	// bytes, latest sample
+uint64_t rss_resizes	= 0;
+uint64_t rss_evictions	= 0;
+
+// Multi-process mode (-follow_execv): the page lists and their locks live
+// in a shared segment that every descendant maps at the same address.
+// Counters and caches stay per process; each writes its own report.
+enum { SHM_UNCLIST = 0, SHM_CLIST = 1 };
+enum { SHM_UNC_LOCK = 0, SHM_C_LOCK = 1 };
+constexpr uint64_t SHM_HINT = 0x6f0000000000ULL;   // away from heap/mmap bases
+SHMARENA::Arena*   shm = nullptr;
+std::string        shmName;
+bool               shmRoot = false;
+INSTLIB::FOLLOW_CHILD followChild;
+std::vector<char*> childPrefix;			// our command line + -shm_name
+
+// TLBs (-tlb): per-thread L1 dTLB/iTLB and page-walk cache, one shared L2
+// TLB. Entries are 4 KiB (or -pagesize) or 2 MiB in -thp ranges. A miss in
+// both walks a 4-level table whose entries live in PT_REGION (kernel half,
+// never an application address); those reads go through L1/L2 and the page
+// tiers like any other access.
+bool tlbOn = false;
+constexpr uint64_t PT_REGION = 0xffff900000000000ULL;
+struct ThreadTlbs { TLBSIM::Tlb dtlb, itlb, pwc; };
+std::vector<ThreadTlbs*> tlbs;			// per thread
+TLBSIM::Tlb* stlb = nullptr;
+PIN_LOCK     stlbLock;
+uint64_t tlbRetired[3][2] = {};			// {dtlb, itlb, pwc} x {hits, misses}
+std::atomic<uint64_t> page_walks{0};
+std::atomic<uint64_t> walk_refs{0};
+
+// Memory the application hands back (munmap, madvise, brk shrink) leaves
+// both tiers at syscall exit. Arguments are stashed per thread at entry,
+// along with what -regions needs to classify an mmap.
+struct PendingRelease {
+	uint64_t lo = 0, hi = 0;
+	bool brk = false, unmap = false, mmap = false;
+	int  kind = 0;
+};
+std::vector<PendingRelease> pendingRelease;	// by tid
+std::atomic<uint64_t> curBrk{0};
+uint64_t release_calls		= 0;
+uint64_t released_unclist	= 0;
+uint64_t released_clist		= 0;
+
+// Checkpoint/restore (-checkpoint_at, -restore_from). A restored run only
+// counts instructions until it reaches the checkpoint's count, then goes on
+// simulating from the saved caches, page lists and counters.
+std::atomic<uint64_t> checkpointAt{0};	// 0: none pending, or being taken
+uint64_t fastForwardTo = 0;
+struct RestoredUnit { std::vector<Line> lines; uint64_t acc = 0, miss = 0; };
+std::unordered_map<uint32_t, RestoredUnit> restoredUnits;	// private caches,
+														// picked up in ThreadStart
+uint64_t restoredStats[4] = {0, 0, 0, 0};	// ins, memIns, reads, writes
+
+// Internal tool threads, stopped from PrepareForFini
+std::atomic<bool> toolExiting{false};
+std::vector<PIN_THREAD_UID> toolThreads;
+
+// Cost model (-lat_*), in the units of -lat_unit
+struct CostModel { double lvl[MAX_LEVELS], uncl, cl, cpage, promote, recomp, base_cpi; };
+CostModel cost;
+
 struct StatPack { 
 	std::atomic<uint64_t> ins=0;
 	std::atomic<uint64_t> memIns=0;
 	std::atomic<uint64_t> reads=0;
 	std::atomic<uint64_t> writes=0; 
+	std::atomic<uint64_t> mappedHits=0;		// -scan: accesses that set an accessed bit
+	std::atomic<uint64_t> mappedCode=0;
+	std::atomic<uint64_t> regionHits[3] = {};	// -damon: accesses by placed tier
+	std::atomic<uint64_t> regionCode[3] = {};
+	std::atomic<uint64_t> kindAcc[MEMREGIONS::KINDS][RK_COUNTS] = {};	// -regions
+	std::atomic<uint64_t> privAcc=0;		// -privtier: accesses, and hits
+	std::atomic<uint64_t> privHits=0;
 };
 std::vector<std::unique_ptr<StatPack>> stats;
 
@@ -207,359 +787,3178 @@ std::vector<std::unique_ptr<StatPack>> stats;
 // Helper methods and prototypes
 // -----------------------------------------------------------------------
 VOID CacheCall(THREADID, UINT32, UINT64, UINT64, UINT64, UINT32, bool, int, UINT64);
-VOID RecordMemRead (VOID*, VOID*, UINT32, ADDRINT, ADDRINT, THREADID);
-VOID RecordMemWrite(VOID*, VOID*, UINT32, ADDRINT, ADDRINT, THREADID);
+VOID RecordMemRead (VOID*, VOID*, UINT32, UINT32, ADDRINT, ADDRINT, THREADID);
+VOID RecordMemWrite(VOID*, VOID*, UINT32, UINT32, ADDRINT, ADDRINT, THREADID);
 
 // -----------------------------------------------------------------------
-// CacheCall cache access routine
+// Page granularity. In mixed mode an address inside a huge-page-backed
+// range maps to its 2 MiB base; since that base is also a multiple of the
+// list page size, it keys a single, collision-free node.
 // -----------------------------------------------------------------------
-VOID CacheCall(THREADID tid, UINT32 op, UINT64 /*icount*/, UINT64 /*pc*/,
-               UINT64 blkAddr, UINT32 /*stk*/, bool /*isPT*/, int /*accType*/, UINT64 vp_addr)
+static bool InHugeRange(uint64_t addr)
 {
-    SimpleCache& l1 = *L1[tid];
+	PIN_RWMutexReadLock(&hugeLock);
+	auto it = std::upper_bound(hugeRanges.begin(), hugeRanges.end(),
+							   std::make_pair(addr, MAXVAL));
+	bool huge = it != hugeRanges.begin() && addr < std::prev(it)->second;
+	PIN_RWMutexUnlock(&hugeLock);
+	return huge;
+}
 
-	// L1 hit
-    if(l1.Access(blkAddr, op==WRITE_OP, nullptr, nullptr))
-	{
-		return;
+static uint64_t PageAddr(uint64_t addr)
+{
+	if (mixedPages && InHugeRange(addr)) {
+		++huge_accesses;
+		return addr & ~(HUGE_PAGE_SIZE - 1);
 	}
+	return addr;
+}
 
-    bool l2Hit;
-    {
-        PIN_GetLock(&l2Lock, 0);
-        l2Hit = L2->Access(blkAddr, op==WRITE_OP,
-                 /*install in L1*/ [&](uint64_t a,bool d){ l1.Install(a,d); },
-                 /*mem write-back*/ [](uint64_t /*a*/){});
-        PIN_ReleaseLock(&l2Lock);
-    }
+static uint64_t PageBytes(uint64_t vp_addr)
+{
+	return (mixedPages && InHugeRange(vp_addr)) ? HUGE_PAGE_SIZE : page_size;
+}
 
-    if(!l2Hit){
-	/*	
-		Procedure:
-		Check for promotions in compressed->uncompressed
-		Check if node is in either list
-		If uncompressed LRU is not full, add a node
-		If compressed LRU is not full, add a node
-		If its a hit on a compressed list page, and access threshold is hit for unclist
-			Promotion of clist page is needed, evict from unclist and add new page
-		If it is in neither, it is a compressed page *outside* LRU
-		Eviction is needed for the compressed list, use knob for clist for frequency
- 	*/		
+// -----------------------------------------------------------------------
+// Rebuild hugeRanges from smaps. hugetlbfs mappings are huge throughout;
+// for THP, smaps only says how much of a VMA is huge, not where, so the
+// 2 MiB-aligned interior counts as huge once THP backs at least half of it.
+// -----------------------------------------------------------------------
+static void RefreshHugeRanges()
+{
+	std::vector<PROCFS::Mapping> maps;
+	if (!PROCFS::read_maps(PIN_GetPid(), maps, true)) return;
 
-		PIN_GetLock(&unc_lock, tid+1);
-		if (!unclist->isFull()) {
-			unclist->touch(vp_addr);          // insert as MRU
-			++unclist_access;
-			PIN_ReleaseLock(&unc_lock);
-			return;
-		}
-		PIN_ReleaseLock(&unc_lock);
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+	for (auto& m : maps) {
+		uint64_t lo = (m.start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		uint64_t hi = m.end & ~(HUGE_PAGE_SIZE - 1);
+		if (hi <= lo) continue;
+		if (m.kernel_page_kb * 1024 >= HUGE_PAGE_SIZE ||
+			m.anon_huge_kb * 1024 * 2 >= hi - lo)
+			ranges.push_back({ lo, hi });
+	}
 
-		/*  Step 2 : insert into clist if it still has room */
-		PIN_GetLock(&c_lock, tid+1);
-		if (!clist->isFull()) {
-			clist->touch(vp_addr);            // insert / move to MRU
-			++clist_access;
-			PIN_ReleaseLock(&c_lock);
-			return;
-		}
-		PIN_ReleaseLock(&c_lock);
-
-		/*  Step 0 : lists are full –– do we swap? (promotion) */
-		PIN_GetLock(&unc_lock, tid+1);
-		PIN_GetLock(&c_lock,  tid+1);
-		if (uc_epoch >= expansionFrequency) {
-			clist->swap_with(*unclist);       // promotion
-			uc_epoch = 0;                     // both lists mutated
-		}
-		PIN_ReleaseLock(&c_lock);
-		PIN_ReleaseLock(&unc_lock);
-
-		/*  Step 3 : page is already in unclist */
-		PIN_GetLock(&unc_lock, tid+1);
-		auto victim = unclist->find_node(vp_addr);
-		if (victim) {
-			++unclist_access;
-			if (uc_epoch >= unclist_freq) {
-				unclist->touch(vp_addr);      // refresh order
-				uc_epoch = 0;
-			} else {
-				unclist->increment_count(vp_addr);
-			}
-			PIN_ReleaseLock(&unc_lock);
-			return;
-		}
-		PIN_ReleaseLock(&unc_lock);
-
-		/*  Step 4 : page is already in clist, or try to insert/refresh there */
-		PIN_GetLock(&c_lock, tid+1);
-		victim = clist->find_node(vp_addr);
-		if (victim) {
-			++clist_access;
-			if (cl_epoch >= clist_freq) {
-				clist->touch(vp_addr);        // refresh / move to MRU
-				cl_epoch = 0;
-			} else {
-				clist->increment_count(vp_addr);
-			}
-			PIN_ReleaseLock(&c_lock);
-			return;
-		}
+	PIN_RWMutexWriteLock(&hugeLock);
+	hugeRanges.swap(ranges);
+	PIN_RWMutexUnlock(&hugeLock);
+}
 
-		if (cl_epoch >= clist_freq) {         // insert new page, evicting LRU
-			clist->touch(vp_addr);
-			++cpage_access;
-			cl_epoch = 0;
-			PIN_ReleaseLock(&c_lock);
-			return;
-		}
-		PIN_ReleaseLock(&c_lock);
+// -----------------------------------------------------------------------
+// Internal threads sleep in short slices so process exit isn't held up.
+// -----------------------------------------------------------------------
+static void ToolSleep(UINT32 ms)
+{
+	while (ms && !toolExiting) {
+		UINT32 slice = std::min<UINT32>(ms, 50);
+		PIN_Sleep(slice);
+		ms -= slice;
+	}
+}
 
-		/*  Step 5 : none of the above –– count as compressed-page miss */
-		PIN_GetLock(&cpage_lock, tid+1);
-		++cpage_access;
-		PIN_ReleaseLock(&cpage_lock);
-    }
+static VOID SmapsThread(VOID*)
+{
+	while (!toolExiting) {
+		RefreshHugeRanges();
+		ToolSleep(KnobSmapsPeriod.Value());
+	}
+	PIN_ExitThread(0);
 }
 
 // -----------------------------------------------------------------------
-// Recording memory reads/writes
+// Memory regions (-regions). The maps file is the authority; image loads
+// and the mmap family patch the map in between re-reads so new memory is
+// classified from its first access.
 // -----------------------------------------------------------------------
-VOID RecordMemRead(VOID* ip, VOID* addr, UINT32 stk,
-                   ADDRINT rbp, ADDRINT rsp, THREADID tid)
+static MEMREGIONS::Kind RegionKind(uint64_t addr)
 {
-	++uc_epoch;
-	++cl_epoch;
+	PIN_RWMutexReadLock(&regionLock);
+	MEMREGIONS::Kind k = memRegions.kind_of(addr);
+	PIN_RWMutexUnlock(&regionLock);
+	return k;
+}
 
-    (void)ip; (void)rbp; (void)rsp; (void)stk;
-    stats[tid]->memIns.fetch_add(1, std::memory_order_relaxed);
-	stats[tid]->reads.fetch_add(1, std::memory_order_relaxed);
-	UINT64 vp_addr = (UINT64)addr;
-    CacheCall(tid, READ_OP, 0, (UINT64)ip,
-              ((UINT64)addr + CACHELINE_OFFSET) & DATA_BLOCK_FLOOR_ADDR_MASK,
-              stk, false, access_data, vp_addr);
+static void SetRegion(uint64_t lo, uint64_t hi, MEMREGIONS::Kind kind)
+{
+	if (!regionsOn) return;
+	PIN_RWMutexWriteLock(&regionLock);
+	memRegions.set(lo, hi, kind);
+	PIN_RWMutexUnlock(&regionLock);
 }
 
-VOID RecordMemWrite(VOID* ip, VOID* addr, UINT32 stk,
-                    ADDRINT rbp, ADDRINT rsp, THREADID tid)
+static void ClearRegion(uint64_t lo, uint64_t hi)
 {
-	++uc_epoch;
-	++cl_epoch;
+	if (!regionsOn) return;
+	PIN_RWMutexWriteLock(&regionLock);
+	memRegions.clear(lo, hi);
+	PIN_RWMutexUnlock(&regionLock);
+}
 
-    (void)ip; (void)rbp; (void)rsp; (void)stk;
-    stats[tid]->memIns.fetch_add(1, std::memory_order_relaxed);
-	stats[tid]->writes.fetch_add(1, std::memory_order_relaxed);
-	UINT64 vp_addr = (UINT64)addr;
-    CacheCall(tid, WRITE_OP, 0, (UINT64)ip,
-              ((UINT64)addr + CACHELINE_OFFSET) & DATA_BLOCK_FLOOR_ADDR_MASK,
-              stk, false, access_data, vp_addr);
+static void RefreshRegions()
+{
+	std::vector<PROCFS::Mapping> maps;
+	if (!PROCFS::read_maps(PIN_GetPid(), maps, false)) return;
+	PIN_RWMutexWriteLock(&regionLock);
+	memRegions.assign(maps, threadStacks);
+	PIN_RWMutexUnlock(&regionLock);
+}
+
+static VOID RegionsThread(VOID*)
+{
+	while (!toolExiting) {
+		ToolSleep(KnobRegionsPeriod.Value());
+		RefreshRegions();
+	}
+	PIN_ExitThread(0);
+}
+
+// Sections of a loaded image: executable ones are code, the rest file.
+static VOID RegionImageLoad(IMG img, VOID*)
+{
+	for (SEC sec = IMG_SecHead(img); SEC_Valid(sec); sec = SEC_Next(sec)) {
+		if (!SEC_Mapped(sec) || !SEC_Size(sec)) continue;
+		uint64_t lo = SEC_Address(sec) & ~(BASE_PAGE_SIZE - 1);
+		uint64_t hi = (SEC_Address(sec) + SEC_Size(sec) + BASE_PAGE_SIZE - 1) & ~(BASE_PAGE_SIZE - 1);
+		SetRegion(lo, hi, SEC_IsExecutable(sec) ? MEMREGIONS::KIND_CODE : MEMREGIONS::KIND_FILE);
+	}
+}
+
+static VOID RegionImageUnload(IMG img, VOID*)
+{
+	ClearRegion(IMG_LowAddress(img), IMG_HighAddress(img) + 1);
+}
+
+// Page-tier access of one kind (RK_*) to the page at vp_addr.
+static void RegionCount(THREADID tid, uint64_t vp_addr, int what)
+{
+	if (!regionsOn) return;
+	stats[tid]->kindAcc[RegionKind(vp_addr)][what].fetch_add(1, std::memory_order_relaxed);
 }
 
 // -----------------------------------------------------------------------
-// Instrumentation functions
+// Resize both lists to their share of the application's RSS. The RSS that
+// statm reports includes Pin and this tool, so the startup baseline and
+// the tool's own page-list nodes are taken out first.
 // -----------------------------------------------------------------------
-VOID Instruction(INS ins, VOID*)
+static bool SampleRss(uint64_t& bytes)
 {
-    UINT32 stkStatus = 0;                 // could refine with REG_RSP vs REG_RBP
+	uint64_t size, rss;
+	if (!PROCFS::read_statm(PIN_GetPid(), size, rss)) return false;
+	bytes = rss * BASE_PAGE_SIZE;
+	return true;
+}
 
-    if(INS_IsMemoryRead(ins))
-        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMemRead,
-            IARG_INST_PTR, IARG_MEMORYREAD_EA, IARG_UINT32, stkStatus,
-            IARG_REG_VALUE, REG_RBP, IARG_REG_VALUE, REG_RSP,
-            IARG_THREAD_ID, IARG_END);
+// -----------------------------------------------------------------------
+// Shadow entries. Evictions are recorded under the tier's lock; refaults
+// are checked where an access is known to miss the tier.
+// -----------------------------------------------------------------------
+static void ShadowEvict(int tier, uint64_t vp_num)
+{
+	if (!shadows[tier]) return;
+	PIN_GetLock(&shadow_lock, PIN_ThreadId()+1);
+	shadows[tier]->evict(vp_num);
+	PIN_ReleaseLock(&shadow_lock);
+}
 
-    if(INS_IsMemoryWrite(ins))
-        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMemWrite,
-            IARG_INST_PTR, IARG_MEMORYWRITE_EA, IARG_UINT32, stkStatus,
-            IARG_REG_VALUE, REG_RBP, IARG_REG_VALUE, REG_RSP,
-            IARG_THREAD_ID, IARG_END);
+static void ShadowRefault(THREADID tid, int tier, uint64_t vp_addr)
+{
+	if (!shadows[tier]) return;
+	uint64_t distance;
+	PIN_GetLock(&shadow_lock, tid+1);
+	shadows[tier]->refault(vp_addr >> page_shift, distance);
+	PIN_ReleaseLock(&shadow_lock);
+}
 
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)+[](THREADID tid){
-    stats[tid]->ins.fetch_add(1, std::memory_order_relaxed);
-		uint64_t cur = ++globalIns;                        // total instructions
-		if ((cur - lastReportIns.load(std::memory_order_relaxed)) > MAX_INTERVAL)
-		{
-			// let **one** thread do the report
-			if (lastReportIns.compare_exchange_strong(cur, cur))
-			{
-				/* 
-					Maybe locking is needed here? At the very least check
-					In any case, this is where we will also flush out all
-					counters for both clist and unclist accesses.
-					LRU order is preserved, we just want to record and 
-					prevent an integer overflow. 
-					I guess flushing is not needed if we just use a uint64.
-					Maybe flush just in case? Not sure we'll ever hit that
-					cap but it wouldn't hurt to be sure. God knows how many
-					instructions are present in a seven-to-ten hour benchmark.
-				 */
-				// -------- aggregate L1 --------
-				uint64_t l1Acc = 0, l1Miss = 0;
-				for (auto* c : L1) {
-					if (c) { l1Acc += c->Accesses(); l1Miss += c->Misses(); }
-				}
-
-				// -------- aggregate L2 --------
-				uint64_t l2Acc  = L2 ? L2->Accesses() : 0;
-				uint64_t l2Miss = L2 ? L2->Misses()   : 0;
-
-				// -------- print report --------
-				Out << "\n[Report @ " << cur << " instructions]\n"
-						<< "  L1 accesses : " << l1Acc
-						<< "\n  misses: "     << l1Miss
-						<< "\n  MPKI: "       << std::fixed << std::setprecision(2)
-						<< (cur ? 1000.0 * l1Miss / cur : 0.0) << '\n'
-						<< "  L2 accesses : " << l2Acc
-						<< "\n  misses: "     << l2Miss
-						<< "\n  MPKI: "       << std::fixed << std::setprecision(2)
-						<< (cur ? 1000.0 * l2Miss / cur : 0.0) << "\n"
-						<< "\n  Clist Accesses: " << clist_access
-						<< "\n  Unclist Accesses: " << unclist_access
-						<< "\n  Cpage   Accesses: " << cpage_access;
+static void ResizeTiers()
+{
+	uint64_t rss;
+	if (!SampleRss(rss)) return;
 
-				// Statistics reset occurs here:
-				PIN_GetLock(&reset_lock, tid+1);
-				for (auto * c : L1)
-				{
-					if (c)
-					{
-						c->ResetStats();
-					}
-				}
-
-				if (L2)
-				{
-					L2->ResetStats();
-				}
-							
-				unclist->reset_counters();
-				clist->reset_counters();
-				clist_access	= 0;
-				unclist_access	= 0;
-				cpage_access	= 0;
-				for (auto& sptr : stats) {
-					if (sptr) {
-						sptr->ins   .store(0, std::memory_order_relaxed);
-						sptr->memIns.store(0, std::memory_order_relaxed);
-						sptr->reads .store(0, std::memory_order_relaxed);
-						sptr->writes.store(0, std::memory_order_relaxed);
-					}
-				}
+	THREADID me = PIN_ThreadId();
+	uint64_t nodes = unclist->get_size() + clist->get_size();
+	uint64_t own   = rss_base + nodes * (sizeof(HashLL::hash_node) + 32);
+	rss_app = rss > own ? rss - own : 0;
 
-				PIN_ReleaseLock(&reset_lock);
-			}
-		}
-		else if ((cur - lastReportIns.load(std::memory_order_relaxed)) > REPORT_INTERVAL)
-		{
-			// let **one** thread do the report
-			if (lastReportIns.compare_exchange_strong(cur, cur))
-			{
-				// -------- aggregate L1 --------
-				uint64_t l1Acc = 0, l1Miss = 0;
-				for (auto* c : L1) {
-					if (c) { l1Acc += c->Accesses(); l1Miss += c->Misses(); }
-				}
-
-				// -------- aggregate L2 --------
-				uint64_t l2Acc  = L2 ? L2->Accesses() : 0;
-				uint64_t l2Miss = L2 ? L2->Misses()   : 0;
-
-				// -------- print report --------
-				Out << "\n[Report @ " << cur << " instructions]\n"
-						<< "  L1 accesses : " << l1Acc
-						<< "\n  misses: "     << l1Miss
-						<< "\n  MPKI: "       << std::fixed << std::setprecision(2)
-						<< (cur ? 1000.0 * l1Miss / cur : 0.0) << '\n'
-						<< "  L2 accesses : " << l2Acc
-						<< "\n  misses: "     << l2Miss
-						<< "\n  MPKI: "       << std::fixed << std::setprecision(2)
-						<< (cur ? 1000.0 * l2Miss / cur : 0.0) << "\n"
-						<< "\n  Clist Accesses: " << clist_access
-						<< "\n  Unclist Accesses: " << unclist_access
-						<< "\n  Cpage   Accesses: " << cpage_access;
-			}
+	auto pages = [](double pct) {
+		uint64_t n = (uint64_t)(rss_app * pct / 100.0) >> page_shift;
+		return (uint32_t)std::min<uint64_t>(std::max<uint64_t>(n, 1),
+											std::numeric_limits<uint32_t>::max());
+	};
+
+	if (unclpct > 0) {
+		unc_lock.Get(me);
+		rss_evictions += tiers->resize_unclist(pages(unclpct));
+		unc_lock.Release();
+	}
+	if (clpct > 0) {
+		c_lock.Get(me);
+		uint32_t cap = pages(clpct);
+		if (cmodel) {	// pool bytes, entries bounded by their overhead
+			uint64_t bytes = (uint64_t)cap << page_shift;
+			clist->set_byte_cap(bytes);
+			cap = (uint32_t)std::min<uint64_t>(bytes / PAGECOMP::ENTRY_OVERHEAD,
+											   std::numeric_limits<uint32_t>::max());
 		}
-	}, IARG_THREAD_ID, IARG_END);
+		rss_evictions += clist->resize(cap);
+		c_lock.Release();
+	}
+	++rss_resizes;
 }
 
-// -----------------------------------------------------------------------
-// Thread spinup and destruction
-// -----------------------------------------------------------------------
-VOID ThreadStart(THREADID tid, CONTEXT*, INT32, VOID*)
+static VOID RssThread(VOID*)
 {
-    if (tid >= L1.size()) {
-        L1.resize(tid+1, nullptr);
-        stats.resize(tid+1);  // now this makes each stats[tid] == nullptr
-    }
-    L1[tid] = new SimpleCache(cfgL1);
-
-    // allocate a new StatPack for this thread
-    stats[tid] = std::make_unique<StatPack>();
+	while (!toolExiting) {
+		ToolSleep(KnobRssPeriod.Value());
+		if (!toolExiting) ResizeTiers();
+	}
+	PIN_ExitThread(0);
 }
 
+static void SpawnToolThread(ROOT_THREAD_FUNC* fn)
+{
+	PIN_THREAD_UID uid;
+	if (PIN_SpawnInternalThread(fn, nullptr, 0, &uid) == INVALID_THREADID) {
+		std::cerr << "Failed to spawn internal tool thread\n";
+		return;
+	}
+	toolThreads.push_back(uid);
+}
 
-VOID ThreadFini(THREADID tid, const CONTEXT*, INT32, VOID*)
+// One more clist hit, cpage access or promotion by the instruction at pc.
+// Prefetches and page walks (pc 0) are not attributed.
+static void PcCount(THREADID tid, uint64_t pc, int kind)
 {
-    delete L1[tid];
+	if (!pcTop || !pc || tid >= pcTables.size() || !pcTables[tid]) return;
+	++(*pcTables[tid])[pc].n[kind];
 }
 
 // -----------------------------------------------------------------------
-// Report print
+// Allocation sites (-allocsites), after ManualExamples/malloctrace. Only
+// the outermost allocator call on a thread counts, so blocks malloc gets
+// from mmap, or a realloc that mallocs, are recorded once. Caller holds
+// alloc_lock.
 // -----------------------------------------------------------------------
-VOID Fini(INT32, VOID*)
+static void AllocDrop(std::map<uint64_t, Alloc>::iterator it)
 {
-    uint64_t totIns=0, totMem=0, rd=0, wr=0;
-    for(auto& s:stats)
-	{ 
-		if (s)
-		{
-			totIns	+= s->ins	.load(std::memory_order_relaxed);
-			totMem	+= s->memIns.load(std::memory_order_relaxed);
-			rd		+= s->reads	.load(std::memory_order_relaxed);
-			wr		+= s->writes.load(std::memory_order_relaxed);
-		}
-	}
+	AllocSite& s = allocSites[it->second.site];
+	--s.live;
+	s.live_bytes -= it->second.hi - it->first;
+	allocs.erase(it);
+}
 
-    Out << std::dec << "\n=========== Cache-Sim Report ============\n";
-    Out << "Total instructions       : " << totIns  << '\n';
-    Out << "  memory instructions    : " << totMem  << '\n';
-    Out << "    reads                : " << rd      << '\n';
-    Out << "    writes               : " << wr      << "\n\n";
+static void AllocAdd(uint64_t lo, uint64_t bytes, uint64_t site)
+{
+	if (!lo || !bytes) return;
+	auto it = allocs.find(lo);
+	if (it != allocs.end()) AllocDrop(it);	// its free was missed
+	allocs[lo] = { lo + bytes, site };
+	AllocSite& s = allocSites[site];
+	++s.allocs;
+	++s.live;
+	s.live_bytes += bytes;
+}
 
-    uint64_t l1Acc=0,l1Miss=0;
-    for(auto* c:L1){ l1Acc+=c->Accesses(); l1Miss+=c->Misses(); }
+static VOID AllocBefore(THREADID tid, UINT32 kind, ADDRINT site, ADDRINT a0, ADDRINT a1)
+{
+	AllocCall& c = *allocCalls[tid];
+	if (c.depth++) return;
+	c.kind = kind;
+	c.site = site;
+	c.a0   = a0;
+	c.a1   = a1;
+}
 
-    Out << "L1 accesses              : "
-              << l1Acc << "   misses: " << l1Miss
-              << "   MPKI: " << std::fixed << std::setprecision(5)
-              << (totIns? (1000.0*l1Miss)/totIns : 0.0) << '\n';
+static VOID AllocAfter(THREADID tid, ADDRINT ret)
+{
+	AllocCall& c = *allocCalls[tid];
+	if (!c.depth || --c.depth) return;
 
-    Out << "L2 accesses              : " << L2->Accesses()
-              << "   misses: " << L2->Misses()
-			  << "   MPKI: " << std::fixed << std::setprecision(5)
-			  << (totIns? (1000.0*L2->Misses())/totIns : 0.0) << '\n';
-			  
-	Out << "\n  Clist Accesses: " << clist_access     << " ("
-		      << std::fixed << std::setprecision(5)
-			  << ((float)clist_access / (float)L2->Misses()) * 100.0 << "%)"
-			  << "\n  Unclist Accesses: " << unclist_access << " ("
-			  << std::fixed << std::setprecision(5)
-			  << ((float)unclist_access / (float)L2->Misses()) * 100.0 << "%)"
-		      << "\n  Cpage   Accesses: " << cpage_access   << " ("
-			  << std::fixed << std::setprecision(5)
-			  << ((float)cpage_access / (float)L2->Misses()) * 100.0 << "%)"
-			  << std::endl;
-    Out << "==========================================\n";
+	PIN_GetLock(&alloc_lock, tid+1);
+	switch (c.kind) {
+	case AL_MALLOC:		AllocAdd(ret, c.a0, c.site); break;
+	case AL_CALLOC:		AllocAdd(ret, c.a0 * c.a1, c.site); break;
+	case AL_REALLOC:
+		if (ret || !c.a1) {		// on failure the old block stays
+			auto it = allocs.find(c.a0);
+			if (it != allocs.end()) AllocDrop(it);
+		}
+		AllocAdd(ret, c.a1, c.site);
+		break;
+	case AL_FREE: {
+		auto it = allocs.find(c.a0);
+		if (it != allocs.end()) AllocDrop(it);
+		break;
+	}
+	case AL_MMAP:
+		if (ret != (ADDRINT)-1) AllocAdd(ret, c.a1, c.site);
+		break;
+	case AL_MUNMAP:
+		if (ret == 0)
+			for (auto it = allocs.lower_bound(c.a0); it != allocs.end() && it->first < c.a0 + c.a1; )
+				AllocDrop(it++);
+		break;
+	}
+	PIN_ReleaseLock(&alloc_lock);
+}
+
+static VOID ImageLoad(IMG img, VOID*)
+{
+	static const struct { const char* name; UINT32 kind; int nargs; } fns[] = {
+		{ "malloc", AL_MALLOC, 1 }, { "calloc", AL_CALLOC, 2 }, { "realloc", AL_REALLOC, 2 },
+		{ "free", AL_FREE, 1 }, { "mmap", AL_MMAP, 2 }, { "munmap", AL_MUNMAP, 2 },
+	};
+	for (auto& f : fns) {
+		RTN rtn = RTN_FindByName(img, f.name);
+		if (!RTN_Valid(rtn)) continue;
+		RTN_Open(rtn);
+		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)AllocBefore, IARG_THREAD_ID,
+					   IARG_UINT32, f.kind, IARG_RETURN_IP,
+					   IARG_FUNCARG_ENTRYPOINT_VALUE, 0,
+					   IARG_FUNCARG_ENTRYPOINT_VALUE, f.nargs > 1 ? 1 : 0, IARG_END);
+		RTN_InsertCall(rtn, IPOINT_AFTER, (AFUNPTR)AllocAfter, IARG_THREAD_ID,
+					   IARG_FUNCRET_EXITPOINT_VALUE, IARG_END);
+		RTN_Close(rtn);
+	}
+}
+
+// A clist hit, for -pcstats and -regions.
+static void CountClist(THREADID tid, uint64_t pc, uint64_t vp_addr)
+{
+	PcCount(tid, pc, PC_CLIST);
+	RegionCount(tid, vp_addr, RK_CLIST);
+}
 
-    delete L2;   // tidy
-	delete unclist;
-	delete clist;
+// A cpage access, for -pcstats, -allocsites and -regions.
+static void CountCpage(THREADID tid, uint64_t pc, uint64_t vp_addr)
+{
+	PcCount(tid, pc, PC_CPAGE);
+	RegionCount(tid, vp_addr, RK_CPAGE);
+	if (!allocTop) return;
+	PIN_GetLock(&alloc_lock, tid+1);
+	auto it = allocs.upper_bound(vp_addr);
+	if (it != allocs.begin() && vp_addr < (--it)->second.hi) ++allocSites[it->second.site].cpage;
+	PIN_ReleaseLock(&alloc_lock);
 }
 
 // -----------------------------------------------------------------------
-// Main method, execution + params here
+// Accessed-bit scanning (-scan), after kstaled and MGLRU's aging walk. A
+// page is mapped from the slow-path access that finds or puts it in
+// unclist until it leaves unclist; accesses to a mapped page only set its
+// bits (MemoryAccess). Every -scan instructions a tool thread walks
+// unclist oldest first, clears the accessed bits and moves the pages that
+// had one to MRU, so unclist is ordered by the last scan that saw each
+// page used. A dirty bit is folded into the node when the scan sees it or
+// the page is demoted: one write, and the page is dirty, so its compressed
+// estimate is redone and demotion recompresses it. clist pages are never
+// mapped: like zswap's, their accesses fault and stay exact.
 // -----------------------------------------------------------------------
-int main(int argc, char* argv[])
+// Caller holds unc_lock; vp_addr is in unclist.
+static void MarkAccessed(uint64_t vp_addr)
+{
+	mapped_bits->set(vp_addr >> page_shift);
+	accessed_bits->set(vp_addr >> page_shift);
+}
+
+// Fold a mapped page's dirty bit into its node. Caller holds the lock of
+// the list `n` is in.
+static void HarvestDirty(HashLL::hash_node* n)
+{
+	if (!dirty_bits->test_and_clear(n->vp_num)) return;
+	++n->writes;
+	n->stale = true;
+	n->dirty = true;
+}
+
+static void Unmap(uint64_t vp_num)
+{
+	if (!mapped_bits) return;
+	mapped_bits->clear(vp_num);
+	accessed_bits->clear(vp_num);
+	dirty_bits->clear(vp_num);
+}
+
+// Move the threads' mapped (-scan) and region (-damon) hits into the
+// tier counters.
+static void FoldThreadHits()
+{
+	if (!mapped_bits && !damon) return;
+	auto take = [](std::atomic<uint64_t>& a) { return a.exchange(0, std::memory_order_relaxed); };
+	THREADID me = PIN_ThreadId();
+	unc_lock.Get(me);
+	for (auto& s : stats) {
+		if (!s) continue;
+		uint64_t n = take(s->mappedHits);
+		unclist_access		+= n + take(s->regionHits[TIER_UNCL]);
+		scan_hits			+= n;
+		code_unclist_access	+= take(s->mappedCode) + take(s->regionCode[TIER_UNCL]);
+	}
+	unc_lock.Release();
+	if (!damon) return;
+
+	c_lock.Get(me);
+	for (auto& s : stats) {
+		if (!s) continue;
+		clist_access		+= take(s->regionHits[TIER_CL]);
+		code_clist_access	+= take(s->regionCode[TIER_CL]);
+	}
+	c_lock.Release();
+	PIN_GetLock(&cpage_lock, me+1);
+	for (auto& s : stats) {
+		if (!s) continue;
+		cpage_access		+= take(s->regionHits[TIER_CPAGE]);
+		code_cpage_access	+= take(s->regionCode[TIER_CPAGE]);
+	}
+	PIN_ReleaseLock(&cpage_lock);
+}
+
+static void ScanTiers()
+{
+	std::vector<uint64_t> walked, young;
+	unc_lock.Get(PIN_ThreadId());
+	unclist->for_each([&](const HashLL::hash_node& n) { walked.push_back(n.vp_num); });
+	for (auto it = walked.rbegin(); it != walked.rend(); ++it) {	// LRU first
+		HarvestDirty(unclist->find_node(*it << page_shift));
+		if (accessed_bits->test_and_clear(*it)) young.push_back(*it);
+	}
+	for (uint64_t vp : young) unclist->touch(vp << page_shift);
+	++scans;
+	scan_pages += walked.size();
+	scan_young += young.size();
+	unc_lock.Release();
+	FoldThreadHits();
+}
+
+static VOID ScanThread(VOID*)
+{
+	while (!toolExiting) {
+		if (!PIN_SemaphoreTimedWait(&scanSem, 50)) continue;
+		PIN_SemaphoreClear(&scanSem);
+		if (!toolExiting) ScanTiers();
+	}
+	PIN_ExitThread(0);
+}
+
+// -----------------------------------------------------------------------
+// DAMON-style tiering (-damon). The monitor watches the application's
+// mappings (less the two largest gaps) as adaptively merged and split
+// regions, checking one page per region every -damon instructions, so its
+// cost is bounded by -damon_max rather than the working set. After each
+// aggregation whole regions are placed, hottest first (older first among
+// equally hot, younger first among idle ones), into unclist while its
+// capacity lasts, then clist, the rest cpage. Pages moved between tiers
+// are counted as region moves, apart from promotions. Accesses outside
+// every region count as cpage. unclist and clist hold no pages, so the
+// reports built from them are skipped or labelled.
+// -----------------------------------------------------------------------
+// Caller holds damonLock.
+static int PlacedTier(uint64_t vp)
+{
+	auto it = std::upper_bound(placement.begin(), placement.end(), vp,
+							   [](uint64_t p, const Placed& r) { return p < r.lo; });
+	return it != placement.begin() && vp < std::prev(it)->hi ? std::prev(it)->tier : TIER_CPAGE;
+}
+
+static void DamonAccess(THREADID tid, bool code, uint64_t vp_addr, uint64_t pc)
+{
+	uint64_t vp = vp_addr >> page_shift;
+	damon_bits->set(vp);
+	PIN_RWMutexReadLock(&damonLock);
+	int tier = PlacedTier(vp);
+	PIN_RWMutexUnlock(&damonLock);
+	stats[tid]->regionHits[tier].fetch_add(1, std::memory_order_relaxed);
+	if (code) stats[tid]->regionCode[tier].fetch_add(1, std::memory_order_relaxed);
+	if (tier == TIER_CL) CountClist(tid, pc, vp_addr);
+	if (tier == TIER_CPAGE) CountCpage(tid, pc, vp_addr);
+}
+
+static void DamonRanges()
+{
+	std::vector<PROCFS::Mapping> maps;
+	if (!PROCFS::read_maps(PIN_GetPid(), maps, false)) return;
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+	for (auto& m : maps) {
+		uint64_t lo = m.start >> page_shift, hi = (m.end + page_size - 1) >> page_shift;
+		if (hi >> REFBITS::Bitmap::KEY_BITS) continue;		// [vsyscall]
+		if (!ranges.empty() && lo <= ranges.back().second)
+			ranges.back().second = std::max(ranges.back().second, hi);
+		else
+			ranges.push_back({ lo, hi });
+	}
+	damon->set_ranges(DAMON::three_regions(ranges));
+}
+
+static void DamonPlace()
+{
+	const std::vector<DAMON::Region>& regs = damon->regions();
+	std::vector<size_t> order(regs.size());
+	for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		const DAMON::Region &x = regs[a], &y = regs[b];
+		if (x.last_nr_accesses != y.last_nr_accesses) return x.last_nr_accesses > y.last_nr_accesses;
+		return x.last_nr_accesses ? x.age > y.age : x.age < y.age;
+	});
+
+	uint64_t room[2] = { unclist->get_cap(), clist->get_cap() };
+	std::vector<Placed> next(regs.size());
+	for (size_t i : order) {
+		int tier = TIER_CPAGE;
+		for (int t = TIER_UNCL; t <= TIER_CL && tier == TIER_CPAGE; ++t)
+			if (regs[i].pages() <= room[t]) { room[t] -= regs[i].pages(); tier = t; }
+		next[i] = { regs[i].lo, regs[i].hi, tier };
+	}
+
+	PIN_RWMutexWriteLock(&damonLock);
+	placement.swap(next);
+	PIN_RWMutexUnlock(&damonLock);
+
+	// pages whose tier changed; only this thread writes placement
+	const std::vector<Placed>& old = next;
+	uint64_t up = 0, down = 0;
+	for (size_t i = 0, j = 0; i < old.size() && j < placement.size(); ) {
+		uint64_t lo = std::max(old[i].lo, placement[j].lo);
+		uint64_t hi = std::min(old[i].hi, placement[j].hi);
+		if (lo < hi && placement[j].tier == TIER_UNCL && old[i].tier != TIER_UNCL) up += hi - lo;
+		if (lo < hi && placement[j].tier > old[i].tier) down += hi - lo;
+		if (old[i].hi < placement[j].hi) ++i; else ++j;
+	}
+	unc_lock.Get(PIN_ThreadId());
+	damon_promoted	+= up;
+	damon_demoted	+= down;
+	unc_lock.Release();
+}
+
+static VOID DamonThread(VOID*)
+{
+	uint32_t aggregations = 0, update = std::max<UINT32>(KnobDamonUpdate.Value(), 1);
+	while (!toolExiting) {
+		if (!PIN_SemaphoreTimedWait(&damonSem, 50)) continue;
+		PIN_SemaphoreClear(&damonSem);
+		if (toolExiting) break;
+		if (!damon->sample([](uint64_t p) { return damon_bits->test_and_clear(p); })) continue;
+		DamonPlace();
+		if (++aggregations % update == 0) DamonRanges();
+	}
+	PIN_ExitThread(0);
+}
+
+// -----------------------------------------------------------------------
+// Compressed footprint of a page: cached estimate, or sample its contents
+// with PIN_SafeCopy and run the estimators. Unreadable bytes count as zero.
+// Pages larger than 4 KiB are estimated from up to EST_SAMPLES evenly
+// spaced 4 KiB chunks, scaled to the full page.
+// -----------------------------------------------------------------------
+constexpr uint64_t EST_SAMPLES = 8;
+
+static uint32_t CompressedFootprint(THREADID tid, uint64_t vp_addr, bool stale)
+{
+	uint64_t vp_num = vp_addr >> page_shift;
+
+	PIN_GetLock(&est_lock, tid+1);
+	auto it = est_cache.find(vp_num);
+	if (it != est_cache.end() && !stale) {
+		++est_reused;
+		uint32_t bytes = it->second.bytes;
+		PIN_ReleaseLock(&est_lock);
+		return bytes + PAGECOMP::ENTRY_OVERHEAD;
+	}
+	PIN_ReleaseLock(&est_lock);
+
+	uint64_t bytes   = PageBytes(vp_addr);
+	uint64_t base    = vp_addr & ~(bytes - 1);
+	uint64_t chunk   = std::min<uint64_t>(bytes, BASE_PAGE_SIZE);
+	uint64_t chunks  = bytes / chunk;
+	uint64_t samples = std::min(chunks, EST_SAMPLES);
+	uint64_t payload = 0;
+	uint32_t kinds[4] = {0, 0, 0, 0};
+
+	uint8_t page[BASE_PAGE_SIZE];
+	for (uint64_t i = 0; i < samples; ++i) {
+		uint64_t at  = base + (i * chunks / samples) * chunk;
+		size_t   got = PIN_SafeCopy(page, (VOID*)at, chunk);
+		if (got < chunk) std::memset(page + got, 0, chunk - got);
+		PAGECOMP::Estimate s = PAGECOMP::estimate(page, chunk, cest_mode);
+		payload += s.bytes;
+		++kinds[s.kind];
+	}
+
+	PAGECOMP::Estimate e;
+	e.bytes = (uint32_t)(payload * chunks / samples);
+	e.kind  = (PAGECOMP::Kind)(std::max_element(kinds, kinds + 4) - kinds);
+
+	PIN_GetLock(&est_lock, tid+1);
+	if (est_bound && est_cache.size() >= est_bound) est_cache.clear();
+	est_cache[vp_num] = e;
+	++est_computed;
+	++est_kind[e.kind];
+	PIN_ReleaseLock(&est_lock);
+	return e.bytes + PAGECOMP::ENTRY_OVERHEAD;
+}
+
+// Charge a page that just entered clist, if it is not charged yet, or
+// recharge it after a recompression. Caller holds c_lock.
+static void ChargeCompressed(THREADID tid, uint64_t vp_addr, bool recompress = false)
+{
+	auto n = clist->find_node(vp_addr);
+	if (!n || (n->csize && !recompress)) return;
+	uint32_t bytes = CompressedFootprint(tid, vp_addr, n->stale);
+	n->stale = false;
+	clist_byte_evictions += clist->set_csize(vp_addr, bytes);
+}
+
+// A page left both tiers: its estimate goes with it.
+static void DropEstimate(uint64_t vp_num)
+{
+	PIN_GetLock(&est_lock, PIN_ThreadId()+1);
+	est_cache.erase(vp_num);
+	PIN_ReleaseLock(&est_lock);
+}
+
+// -----------------------------------------------------------------------
+// Swap tier. The device clock is simulated time: instructions so far at
+// -base_cpi, in -lat_unit units.
+// -----------------------------------------------------------------------
+static double SwapNow()
+{
+	return (double)globalIns.load(std::memory_order_relaxed) * cost.base_cpi;
+}
+
+// unclist evicted a page by itself (RSS resize). Runs under unc_lock.
+static void UnclistEvicted(const HashLL::hash_node& n, void*)
+{
+	ShadowEvict(TIER_UNCL, n.vp_num);
+	Unmap(n.vp_num);
+	if (cmodel) DropEstimate(n.vp_num);
+}
+
+// clist evicted a page: remember it, and with -swap write it back. Runs
+// inside the list, under c_lock.
+static void ClistEvicted(const HashLL::hash_node& n, void*)
+{
+	ShadowEvict(TIER_CL, n.vp_num);
+	if (cmodel) DropEstimate(n.vp_num);
+	if (!swapdev) return;
+	uint64_t vp_addr = n.vp_num << page_shift;
+	PIN_GetLock(&swap_lock, PIN_ThreadId()+1);
+	swapdev->write(n.vp_num, (uint32_t)PageBytes(vp_addr), SwapNow());
+	PIN_ReleaseLock(&swap_lock);
+}
+
+// A page in neither list: true if it was swapped out, which makes this a
+// major fault.
+static bool SwapIn(THREADID tid, uint64_t vp_addr)
+{
+	if (!swapdev) return false;
+	PIN_GetLock(&swap_lock, tid+1);
+	bool major = swapdev->read(vp_addr >> page_shift, SwapNow()) >= 0;
+	PIN_ReleaseLock(&swap_lock);
+	return major;
+}
+
+// True if the page sits on the swap device, so touching it is a major fault.
+static bool Swapped(THREADID tid, uint64_t vp_addr)
+{
+	if (!swapdev) return false;
+	PIN_GetLock(&swap_lock, tid+1);
+	bool out = swapdev->contains(vp_addr >> page_shift);
+	PIN_ReleaseLock(&swap_lock);
+	return out;
+}
+
+// -----------------------------------------------------------------------
+// TinyLFU. `victim` is the page an admission would displace; with none
+// (the list has room) the candidate is always admitted.
+// -----------------------------------------------------------------------
+static void LfuRecord(THREADID tid, uint64_t vp_addr)
+{
+	PIN_GetLock(&lfu_lock, tid+1);
+	lfu->record(vp_addr >> page_shift);
+	PIN_ReleaseLock(&lfu_lock);
+}
+
+static bool LfuAdmits(THREADID tid, uint64_t vp_num, const HashLL::hash_node* victim,
+					  uint64_t& rejects)
+{
+	if (!lfu || !victim) return true;
+	PIN_GetLock(&lfu_lock, tid+1);
+	bool ok = lfu->admit(vp_num, victim->vp_num);
+	if (!ok) ++rejects;
+	PIN_ReleaseLock(&lfu_lock);
+	return ok;
+}
+
+// -----------------------------------------------------------------------
+// Record a write against the page holding `addr`, in whichever list has
+// it. Dirty write-backs also mark the page dirty; a write-back into a
+// compressed page means decompress, modify and recompress in place.
+// -----------------------------------------------------------------------
+static void PageWrite(THREADID tid, uint64_t addr, bool writeback)
+{
+	addr = PageAddr(addr);
+	unc_lock.Get(tid);
+	auto n = unclist->find_node(addr);
+	if (n) {
+		++n->writes;
+		n->stale = true;
+		if (writeback) { n->dirty = true; ++dirty_writebacks; }
+		unc_lock.Release();
+		return;
+	}
+	unc_lock.Release();
+
+	c_lock.Get(tid);
+	n = clist->find_node(addr);
+	if (n) {
+		++n->writes;
+		n->stale = true;
+		if (writeback) {
+			++dirty_writebacks; ++clist_writebacks; ++recompressions;
+			if (cmodel) ChargeCompressed(tid, addr, true);
+		}
+	}
+	c_lock.Release();
+}
+
+// -----------------------------------------------------------------------
+// Released memory. Only tier pages the range covers completely are
+// dropped; what's left of a partially unmapped page ages out as before.
+// -----------------------------------------------------------------------
+static void ReleaseRange(THREADID tid, uint64_t lo, uint64_t hi)
+{
+	lo = (lo + page_size - 1) & ~(page_size - 1);
+	hi &= ~(page_size - 1);
+	if (hi <= lo) return;
+
+	unc_lock.Get(tid);
+	tiers->release(lo >> page_shift, hi >> page_shift);
+	released_unclist += unclist->remove_range(lo, hi);
+	if (mapped_bits)
+		for (auto* bits : { mapped_bits, accessed_bits, dirty_bits })
+			bits->clear_range(lo >> page_shift, hi >> page_shift);
+	++release_calls;
+	unc_lock.Release();
+
+	c_lock.Get(tid);
+	released_clist += clist->remove_range(lo, hi);
+	c_lock.Release();
+
+	if (swapdev) {
+		PIN_GetLock(&swap_lock, tid+1);
+		swapdev->discard(lo >> page_shift, hi >> page_shift);
+		PIN_ReleaseLock(&swap_lock);
+	}
+	if (shadows[TIER_UNCL]) {
+		PIN_GetLock(&shadow_lock, tid+1);
+		for (auto* t : shadows) t->discard(lo >> page_shift, hi >> page_shift);
+		PIN_ReleaseLock(&shadow_lock);
+	}
+
+	if (cmodel) {
+		uint64_t first = lo >> page_shift, last = (hi - 1) >> page_shift;
+		PIN_GetLock(&est_lock, tid+1);
+		if (last - first < est_cache.size()) {
+			for (uint64_t v = first; v <= last; ++v) est_cache.erase(v);
+		} else {
+			for (auto it = est_cache.begin(); it != est_cache.end(); )
+				it = (it->first >= first && it->first <= last) ? est_cache.erase(it) : std::next(it);
+		}
+		PIN_ReleaseLock(&est_lock);
+	}
+}
+
+VOID SyscallEntry(THREADID tid, CONTEXT* ctxt, SYSCALL_STANDARD std, VOID*)
+{
+	PendingRelease& p = pendingRelease[tid];
+	p = PendingRelease{};
+
+	ADDRINT num = PIN_GetSyscallNumber(ctxt, std);
+	ADDRINT a0  = PIN_GetSyscallArgument(ctxt, std, 0);
+	ADDRINT a1  = PIN_GetSyscallArgument(ctxt, std, 1);
+	switch (num) {
+	case SYS_munmap:
+		p.lo = a0; p.hi = a0 + a1;
+		p.unmap = true;
+		break;
+	case SYS_mmap:
+		if (regionsOn) {
+			ADDRINT prot  = PIN_GetSyscallArgument(ctxt, std, 2);
+			ADDRINT flags = PIN_GetSyscallArgument(ctxt, std, 3);
+			p.mmap = true;
+			p.hi = a1;		// length, until the address is known
+			p.kind = (prot & PROT_EXEC) ? MEMREGIONS::KIND_CODE :
+					 !(flags & MAP_ANONYMOUS) ? MEMREGIONS::KIND_FILE :
+					 (flags & MAP_STACK) ? MEMREGIONS::KIND_STACK : MEMREGIONS::KIND_ANON;
+		}
+		break;
+	case SYS_madvise: {
+		ADDRINT advice = PIN_GetSyscallArgument(ctxt, std, 2);
+		if (advice == MADV_DONTNEED || advice == MADV_FREE || advice == MADV_REMOVE) {
+			p.lo = a0; p.hi = a0 + a1;
+		}
+		break;
+	}
+	case SYS_brk:
+		p.brk = true;
+		break;
+	}
+}
+
+VOID SyscallExit(THREADID tid, CONTEXT* ctxt, SYSCALL_STANDARD std, VOID*)
+{
+	PendingRelease p = pendingRelease[tid];
+	pendingRelease[tid] = PendingRelease{};
+	if (!p.brk && !p.mmap && p.hi <= p.lo) return;
+
+	ADDRINT ret = PIN_GetSyscallReturn(ctxt, std);
+	if (p.mmap) {
+		if (ret < (ADDRINT)-4095) SetRegion(ret, ret + p.hi, (MEMREGIONS::Kind)p.kind);
+		return;
+	}
+	// brk returns the (new) break, even on failure; a lower one is a shrink
+	if (p.brk) {
+		uint64_t old = curBrk.exchange(ret);
+		if (old && ret > old) SetRegion(old, ret, MEMREGIONS::KIND_HEAP);
+		if (old && ret < old && globalIns > fastForwardTo) ReleaseRange(tid, ret, old);
+		return;
+	}
+	if (ret == 0 && p.unmap) ClearRegion(p.lo, p.hi);
+	if (ret == 0 && globalIns > fastForwardTo) ReleaseRange(tid, p.lo, p.hi);
+}
+
+// -----------------------------------------------------------------------
+// Cache hierarchy helpers. Each takes and drops one unit's lock at a time.
+// -----------------------------------------------------------------------
+static CacheLevel& Level(size_t i, bool code)
+{
+	return (i == 0 && code) ? l1i : levels[i];
+}
+
+static CacheUnit* Unit(size_t i, THREADID tid, bool code)
+{
+	CacheLevel& L = Level(i, code);
+	return L.shared ? L.units[0] : L.units[Slot(tid)];
+}
+
+// Remove a line from the levels above `lvl`: everyone's copies if `lvl`
+// is shared, otherwise only this thread's (core's). Returns whether any
+// was dirty.
+static bool BackInvalidate(THREADID tid, size_t lvl, uint64_t addr)
+{
+	bool dirty = false;
+	auto inv = [&](CacheUnit* u) {
+		if (!u) return;
+		bool d;
+		PIN_GetLock(&u->lock, tid+1);
+		if (u->cache.Invalidate(addr, d)) ++back_invalidations;
+		PIN_ReleaseLock(&u->lock);
+		dirty |= d;
+	};
+	for (size_t i = 0; i < lvl; ++i) {
+		for (CacheLevel* L : { &levels[i], i == 0 && ifetch ? &l1i : nullptr }) {
+			if (!L) continue;
+			if (L->shared)				inv(L->units[0]);
+			else if (levels[lvl].shared)	for (size_t o = 0; o < unitSpan; ++o) inv(L->units[o]);
+			else						inv(L->units[Slot(tid)]);
+		}
+	}
+	return dirty;
+}
+
+// -----------------------------------------------------------------------
+// Coherence helpers. A shard's lock is taken before any unit lock, never
+// the other way round.
+// -----------------------------------------------------------------------
+static DirShard& Shard(uint64_t line)
+{
+	return dirShards[(line / KnobBlkBytes.Value()) % DIR_SHARDS];
+}
+
+// Run f on each private data cache of a slot, under its lock. The
+// directory's sharers are slots, so threads on one core share a copy.
+template<typename F>
+static void ForPrivate(THREADID tid, uint32_t slot, F f)
+{
+	for (auto& L : levels) {
+		if (L.shared || !L.units[slot]) continue;
+		CacheUnit* u = L.units[slot];
+		PIN_GetLock(&u->lock, tid+1);
+		f(u->cache);
+		PIN_ReleaseLock(&u->lock);
+	}
+}
+
+static bool HeldPrivately(THREADID tid, uint64_t line)
+{
+	bool held = false;
+	ForPrivate(tid, Slot(tid), [&](SimpleCache& c){ held = held || c.Contains(line); });
+	return held;
+}
+
+// Dirty data leaving the private caches goes to the first shared level
+// that holds the line, or to memory.
+static void WriteBackShared(THREADID tid, uint64_t line)
+{
+	for (auto& L : levels) {
+		if (!L.shared) continue;
+		CacheUnit* u = L.units[0];
+		PIN_GetLock(&u->lock, tid+1);
+		bool present = u->cache.MarkDirty(line);
+		PIN_ReleaseLock(&u->lock);
+		if (present) return;
+	}
+	PageWrite(tid, line, true);
+}
+
+// Directory transaction for a data access, before it reaches the caches.
+// Reads that hit a private copy need none.
+static void Cohere(THREADID tid, uint64_t line, bool write, uint64_t pc,
+				   uint32_t off, uint32_t size)
+{
+	if (!write && HeldPrivately(tid, line)) return;
+
+	uint32_t me = Slot(tid);
+	uint64_t bytes = COH::byte_mask(off, size, KnobBlkBytes.Value());
+	DirShard& s = Shard(line);
+	bool dirty = false;
+	PIN_GetLock(&s.lock, tid+1);
+	COH::Outcome o = write ? s.dir.write(line, me, bytes) : s.dir.read(line, me, bytes);
+
+	if (o.coherence_miss) {
+		CohCount &l = s.byLine[line], &p = s.byPC[pc];
+		++coh_misses; ++l.miss; ++p.miss;
+		if (o.false_sharing) { ++coh_false; ++l.false_miss; ++p.false_miss; }
+	}
+	if (o.invalidate) {
+		uint64_t dropped = 0;
+		size_t span = unitSpan;
+		for (uint32_t t = 0; t < span; ++t) {
+			if (t == me || !(o.invalidate & COH::bit(t))) continue;
+			ForPrivate(tid, t, [&](SimpleCache& c){ bool d; dropped += c.Invalidate(line, d); });
+		}
+		++coh_upgrades;
+		if (dropped) {
+			coh_invalidations += dropped;
+			s.byLine[line].inval += dropped;
+			s.byPC[pc].inval += dropped;
+		}
+	}
+	if (o.downgrade) {
+		++coh_downgrades;
+		if (o.writeback)
+			ForPrivate(tid, o.owner, [&](SimpleCache& c){ dirty = c.Clean(line) || dirty; });
+	}
+	PIN_ReleaseLock(&s.lock);
+
+	if (dirty) {
+		++coh_writebacks;
+		WriteBackShared(tid, line);
+	}
+}
+
+// A line left one of a thread's private caches; tell the directory once
+// no private copy is left.
+static void DirLeave(THREADID tid, uint64_t line)
+{
+	if (HeldPrivately(tid, line)) return;
+	DirShard& s = Shard(line);
+	PIN_GetLock(&s.lock, tid+1);
+	s.dir.leave(line, Slot(tid));
+	PIN_ReleaseLock(&s.lock);
+}
+
+static void Evicted(THREADID, size_t, bool, uint64_t, bool);
+
+// Where an evicted line goes: the next exclusive level as a victim, or,
+// if dirty, the first level below that holds it, or memory.
+static void Spill(THREADID tid, size_t lvl, bool code, uint64_t addr, bool dirty)
+{
+	for (size_t k = lvl + 1; k < levels.size(); ++k) {
+		CacheUnit* u = Unit(k, tid, code);
+		if (levels[k].incl == INCL_EXCLUSIVE) {
+			PIN_GetLock(&u->lock, tid+1);
+			SimpleCache::Victim v = u->cache.Fill(addr, dirty);
+			PIN_ReleaseLock(&u->lock);
+			if (v.valid) Evicted(tid, k, code, v.addr, v.dirty);
+			return;
+		}
+		if (!dirty) return;
+		PIN_GetLock(&u->lock, tid+1);
+		bool present = u->cache.MarkDirty(addr);
+		PIN_ReleaseLock(&u->lock);
+		if (present) return;
+	}
+
+	// Dirty line left the hierarchy: the page behind it now differs
+	// from any compressed copy.
+	if (dirty) PageWrite(tid, addr, true);
+}
+
+// A line left level `lvl`. Inclusive levels first pull it out of the
+// levels above, then it spills downwards.
+static void Evicted(THREADID tid, size_t lvl, bool code, uint64_t addr, bool dirty)
+{
+	if (lvl > 0 && levels[lvl].incl == INCL_INCLUSIVE)
+		dirty |= BackInvalidate(tid, lvl, addr);
+	Spill(tid, lvl, code, addr, dirty);
+	if (coherence && !code && !levels[lvl].shared) DirLeave(tid, addr);
+}
+
+// -----------------------------------------------------------------------
+// CacheCall cache access routine
+// -----------------------------------------------------------------------
+// Mark a page that supplied instructions. Caller holds the list's lock.
+static void TagCode(HashLL& list, uint64_t vp_addr)
+{
+	auto n = list.find_node(vp_addr);
+	if (n) n->code = true;
+}
+
+// -sharers. Mark tid as a sharer of a listed page, and count an access
+// served by `tier` as private or shared. Callers hold the list's lock.
+static bool Shared(uint32_t sharers) { return sharers & (sharers - 1); }
+
+static uint32_t ShareMark(THREADID tid, HashLL::hash_node* n)
+{
+	if (!n) return 0;
+	n->sharers |= 1u << (tid % 32);
+	return n->sharers;
+}
+
+static void ShareCount(int tier, uint32_t sharers)
+{
+	share_acc[tier][Shared(sharers)].fetch_add(1, std::memory_order_relaxed);
+}
+
+static void ShareNode(THREADID tid, int tier, HashLL::hash_node* n)
+{
+	if (sharersOn && n) ShareCount(tier, ShareMark(tid, n));
+}
+
+static void Share(THREADID tid, int tier, HashLL& list, uint64_t vp_addr)
+{
+	if (sharersOn) ShareNode(tid, tier, list.find_node(vp_addr));
+}
+
+class PromoteScheme : public TierScheme
+{
+public:
+	const char* name() const override { return "promote"; }
+	void access(THREADID tid, bool code, uint64_t vp_addr, uint64_t pc) override;
+	bool apply_listed(THREADID tid, const Pagevec::Entry& e) override;
+};
+
+class ResidentScheme : public TierScheme
+{
+public:
+	explicit ResidentScheme(TIERPOLICY::PageTierPolicy* p) : policy(p) {}
+	~ResidentScheme() { delete policy; }
+
+	const char* name() const override { return policy->name(); }
+	void access(THREADID tid, bool code, uint64_t vp_addr, uint64_t pc) override;
+	bool apply_listed(THREADID tid, const Pagevec::Entry& e) override;
+	uint32_t resize_unclist(uint32_t pages) override;
+	void release(uint64_t lo, uint64_t hi) override { policy->remove_range(lo, hi); }
+	void restored() override;
+	void report(std::ostream& os) const override { os << " (" << policy->size() << " resident pages)"; }
+
+private:
+	TIERPOLICY::PageTierPolicy* policy;
+};
+
+// -----------------------------------------------------------------------
+// Uncompressed tier under -policy. The policy decides residency and
+// unclist mirrors its resident set to carry the page metadata. A victim
+// drops into clist as its MRU page (with -tinylfu, if admitted), a clist
+// page coming back counts as a promotion, and a page in neither is a
+// compressed-page access.
+// -----------------------------------------------------------------------
+void ResidentScheme::access(THREADID tid, bool code, uint64_t vp_addr, uint64_t pc)
+{
+	uint64_t victim = 0;
+	bool evicted = false, dirty = false, stale = false;
+
+	unc_lock.Get(tid);
+	if (policy->access(vp_addr >> page_shift, victim, evicted)) {
+		++unclist_access;
+		unclist->increment_count(vp_addr);
+		if (code) { ++code_unclist_access; TagCode(*unclist, vp_addr); }
+		Share(tid, TIER_UNCL, *unclist, vp_addr);
+		unc_lock.Release();
+		return;
+	}
+	ShadowRefault(tid, TIER_UNCL, vp_addr);
+	if (evicted) ShadowEvict(TIER_UNCL, victim);
+	victim <<= page_shift;
+	uint32_t victimSharers = 0, sharers = 0, carried = 0;
+	if (evicted) {
+		auto n = unclist->find_node(victim);
+		dirty = n && n->dirty;
+		stale = n && n->stale;
+		victimSharers = n ? n->sharers : 0;
+		unclist->remove(victim);
+	}
+	unclist->touch(vp_addr);
+	if (code) TagCode(*unclist, vp_addr);
+	if (sharersOn) sharers = ShareMark(tid, unclist->find_node(vp_addr));
+	unc_lock.Release();
+
+	c_lock.Get(tid);
+	auto cn = clist->find_node(vp_addr);
+	bool promoted = cn != nullptr;
+	if (!promoted) ShadowRefault(tid, TIER_CL, vp_addr);
+	if (promoted) {
+		carried = cn->sharers;
+		clist->remove(vp_addr);
+		++clist_access;
+		++promotions;
+		if (code) ++code_clist_access;
+		CountClist(tid, pc, vp_addr);
+		PcCount(tid, pc, PC_PROMOTE);
+	}
+	if (evicted && !LfuAdmits(tid, victim >> page_shift, clist->isFull() ? clist->lru_node() : nullptr,
+							  lfu_rejects)) {
+		if (cmodel) DropEstimate(victim >> page_shift);		// left both tiers
+		evicted = false;
+	}
+	if (evicted) {
+		clist->touch(victim);
+		if (dirty) ++recompressions;	// stale compressed copy
+		if (auto v = stale ? clist->find_node(victim) : nullptr) v->stale = true;
+		if (cmodel) ChargeCompressed(tid, victim);
+		if (auto v = victimSharers ? clist->find_node(victim) : nullptr) v->sharers = victimSharers;
+	}
+	c_lock.Release();
+	if (carried & ~sharers) {	// a promoted page keeps its sharers
+		unc_lock.Get(tid);
+		if (auto n = unclist->find_node(vp_addr)) n->sharers |= carried;
+		unc_lock.Release();
+	}
+	bool major = !promoted && SwapIn(tid, vp_addr);
+	if (sharersOn && !major) ShareCount(promoted ? TIER_CL : TIER_CPAGE, sharers | carried);
+	if (promoted || major) return;
+
+	PIN_GetLock(&cpage_lock, tid+1);
+	++cpage_access;
+	if (code) ++code_cpage_access;
+	PIN_ReleaseLock(&cpage_lock);
+	CountCpage(tid, pc, vp_addr);
+}
+
+uint32_t ResidentScheme::resize_unclist(uint32_t pages)
+{
+	std::vector<uint64_t> out;		// the policy picks the victims, unclist follows
+	policy->resize(pages, out);
+	for (uint64_t vp : out) {
+		unclist->remove(vp << page_shift);
+		ShadowEvict(TIER_UNCL, vp);
+	}
+	return (uint32_t)out.size() + unclist->resize(pages);
+}
+
+// Replay the restored pages into the policy, least recent first.
+void ResidentScheme::restored()
+{
+	std::vector<uint64_t> pages;
+	unclist->for_each([&](const HashLL::hash_node& n) { pages.push_back(n.vp_num); });
+	uint64_t victim;
+	bool evicted;
+	for (size_t i = pages.size(); i-- > 0; )
+		policy->access(pages[i], victim, evicted);
+}
+
+// The built-in scheme; vp_addr is page aligned.
+void PromoteScheme::access(THREADID tid, bool code, uint64_t vp_addr, uint64_t pc)
+{
+/*	
+	Procedure:
+	Check for promotions in compressed->uncompressed
+	Check if node is in either list
+	If uncompressed LRU is not full, add a node
+	If compressed LRU is not full, add a node
+	If its a hit on a compressed list page, and access threshold is hit for unclist
+		Promotion of clist page is needed, evict from unclist and add new page
+	If it is in neither, it is a compressed page *outside* LRU
+	Eviction is needed for the compressed list, use knob for clist for frequency
+ 	*/		
+
+	unc_lock.Get(tid);
+	if (!unclist->isFull()) {
+		unclist->touch(vp_addr);          // insert as MRU
+		if (mapped_bits) MarkAccessed(vp_addr);
+		++unclist_access;
+		if (code) { ++code_unclist_access; TagCode(*unclist, vp_addr); }
+		Share(tid, TIER_UNCL, *unclist, vp_addr);
+		unc_lock.Release();
+		return;
+	}
+	unc_lock.Release();
+
+	/*  Step 2 : insert into clist if it still has room */
+	c_lock.Get(tid);
+	if (!clist->isFull()) {
+		clist->touch(vp_addr);            // insert / move to MRU
+		if (cmodel) ChargeCompressed(tid, vp_addr);
+		++clist_access;
+		if (code) { ++code_clist_access; TagCode(*clist, vp_addr); }
+		Share(tid, TIER_CL, *clist, vp_addr);
+		c_lock.Release();
+		CountClist(tid, pc, vp_addr);
+		return;
+	}
+	c_lock.Release();
+
+	/*  Step 0 : lists are full –– do we swap? (promotion) */
+	unc_lock.Get(tid);
+	c_lock.Get(tid);
+	if (uc_epoch >= expansionFrequency) {
+		// with -tinylfu the hottest clist page must also be more popular
+		// than the unclist page it would displace
+		HashLL::hash_node* hot = lfu ? clist->hottest_node() : nullptr;
+		bool admit = !hot || LfuAdmits(tid, hot->vp_num, unclist->lru_node(), lfu_promote_rejects);
+		auto demoted = admit ? clist->swap_with(*unclist, hot) : nullptr;   // promotion
+		if (demoted) {
+			++promotions;
+			PcCount(tid, pc, PC_PROMOTE);
+			ShadowEvict(TIER_UNCL, demoted->vp_num);
+			if (mapped_bits) HarvestDirty(demoted);
+			Unmap(demoted->vp_num);
+		}
+		if (demoted && demoted->dirty) {  // stale compressed copy
+			++recompressions;
+			demoted->dirty = false;
+		}
+		if (cmodel && demoted)		// swap_with left it uncharged
+			ChargeCompressed(tid, demoted->vp_num << page_shift);
+		uc_epoch = 0;                     // both lists mutated
+	}
+	c_lock.Release();
+	unc_lock.Release();
+
+	/*  Step 3 : page is already in unclist */
+	unc_lock.Get(tid);
+	auto victim = unclist->find_node(vp_addr);
+	if (victim) {
+		++unclist_access;
+		if (code) { ++code_unclist_access; victim->code = true; }
+		ShareNode(tid, TIER_UNCL, victim);
+		if (mapped_bits) {
+			MarkAccessed(vp_addr);        // the scanner orders it
+		} else if (uc_epoch >= unclist_freq) {
+			unclist->touch(vp_addr);      // refresh order
+			uc_epoch = 0;
+		} else {
+			unclist->increment_count(vp_addr);
+		}
+		unc_lock.Release();
+		return;
+	}
+	unc_lock.Release();
+
+	/*  Step 4 : page is already in clist, or try to insert/refresh there */
+	ShadowRefault(tid, TIER_UNCL, vp_addr);
+	c_lock.Get(tid);
+	victim = clist->find_node(vp_addr);
+	if (victim) {
+		++clist_access;
+		if (code) { ++code_clist_access; victim->code = true; }
+		ShareNode(tid, TIER_CL, victim);
+		if (cl_epoch >= clist_freq) {
+			clist->touch(vp_addr);        // refresh / move to MRU
+			cl_epoch = 0;
+		} else {
+			clist->increment_count(vp_addr);
+		}
+		c_lock.Release();
+		CountClist(tid, pc, vp_addr);
+		return;
+	}
+
+	// insert new page, evicting LRU. A major fault always comes in: its
+	// swap slot is freed by the read, so the page has nowhere else to live.
+	if (Swapped(tid, vp_addr) ||
+		(cl_epoch >= clist_freq &&
+		 LfuAdmits(tid, vp_addr >> page_shift, clist->isFull() ? clist->lru_node() : nullptr,
+				   lfu_rejects))) {
+		ShadowRefault(tid, TIER_CL, vp_addr);
+		bool major = SwapIn(tid, vp_addr);
+		clist->touch(vp_addr);
+		if (cmodel) ChargeCompressed(tid, vp_addr);
+		if (!major) ++cpage_access;
+		if (code) { code_cpage_access += !major; TagCode(*clist, vp_addr); }
+		if (major) { if (sharersOn) ShareMark(tid, clist->find_node(vp_addr)); }
+		else Share(tid, TIER_CPAGE, *clist, vp_addr);
+		cl_epoch = 0;
+		c_lock.Release();
+		if (!major) CountCpage(tid, pc, vp_addr);
+		return;
+	}
+	c_lock.Release();
+
+	/*  Step 5 : none of the above –– count as compressed-page miss (a
+		swapped-out page was brought into clist by step 4) */
+	ShadowRefault(tid, TIER_CL, vp_addr);
+	PIN_GetLock(&cpage_lock, tid+1);
+	++cpage_access;
+	if (code) ++code_cpage_access;
+	PIN_ReleaseLock(&cpage_lock);
+	CountCpage(tid, pc, vp_addr);
+}
+
+// One page-tier access; vp_addr is page aligned.
+static void TierAccess(THREADID tid, UINT32 op, bool code, UINT64 vp_addr, uint64_t pc)
+{
+	if (op == WRITE_OP) PageWrite(tid, vp_addr, false);
+	if (lfu) LfuRecord(tid, vp_addr);
+	tiers->access(tid, code, vp_addr, pc);
+}
+
+// -----------------------------------------------------------------------
+// Pagevecs, like the kernel's per-CPU LRU batches. A thread's accesses
+// queue until its buffer fills, its oldest entry is -pagevec_ins of its
+// instructions old (checked on each of its instructions), it exits, or a
+// checkpoint is taken. A flush applies the entries in order: a run of
+// pages already listed goes under one unc_lock/c_lock acquisition, and
+// the first entry that isn't goes through TierAccess before the next run.
+// Promotions (step 0) are only considered there.
+// -----------------------------------------------------------------------
+// Apply the access if the page is listed (the write as PageWrite counts
+// it). Caller holds unc_lock and c_lock.
+bool ResidentScheme::apply_listed(THREADID tid, const Pagevec::Entry& e)
+{
+	uint64_t vp = e.vp_addr, victim;
+	bool evicted;
+	HashLL::hash_node* n = unclist->find_node(vp);
+	if (!n) return false;
+	policy->access(vp >> page_shift, victim, evicted);	// a hit: nothing evicted
+	unclist->increment_count(vp);
+	++unclist_access;
+	if (e.code) ++code_unclist_access;
+	ShareNode(tid, TIER_UNCL, n);
+	if (e.write) { ++n->writes; n->stale = true; }
+	if (e.code) n->code = true;
+	return true;
+}
+
+bool PromoteScheme::apply_listed(THREADID tid, const Pagevec::Entry& e)
+{
+	uint64_t vp = e.vp_addr;
+	// while clist is still filling, step 2 takes every access unclist can't
+	bool filling = unclist->isFull() && !clist->isFull();
+	HashLL::hash_node* n = filling ? nullptr : unclist->find_node(vp);
+	if (n) {
+		if (!unclist->isFull()) unclist->touch(vp);
+		else if (mapped_bits) MarkAccessed(vp);
+		else if (uc_epoch >= unclist_freq) { unclist->touch(vp); uc_epoch = 0; }
+		else unclist->increment_count(vp);
+		++unclist_access;
+		if (e.code) ++code_unclist_access;
+		ShareNode(tid, TIER_UNCL, n);
+	}
+	// clist hits once both lists are full (step 4)
+	else if (clist->isFull() && unclist->isFull() && (n = clist->find_node(vp))) {
+		if (cl_epoch >= clist_freq) { clist->touch(vp); cl_epoch = 0; }
+		else clist->increment_count(vp);
+		++clist_access;
+		if (e.code) ++code_clist_access;
+		ShareNode(tid, TIER_CL, n);
+		CountClist(tid, e.pc, vp);
+	}
+	else return false;
+
+	if (e.write) { ++n->writes; n->stale = true; }
+	if (e.code) n->code = true;
+	return true;
+}
+
+// `tid` only names the lock owner: a checkpoint flushes every thread's,
+// and the accesses stay the owner's.
+static void PagevecFlush(THREADID tid, Pagevec& pv)
+{
+	if (!pv.n) return;
+	uint32_t n = pv.n, i = 0;
+	pv.n = 0;
+
+	while (i < n) {
+		uint32_t from = i;
+		unc_lock.Get(tid);
+		c_lock.Get(tid);
+		if (!from) ++pagevec_flushes;
+		while (i < n && tiers->apply_listed(pv.owner, pv.e[i])) ++i;
+		pagevec_batched += i - from;
+		c_lock.Release();
+		unc_lock.Release();
+
+		if (lfu && i > from) {
+			PIN_GetLock(&lfu_lock, tid+1);
+			for (uint32_t j = from; j < i; ++j) lfu->record(pv.e[j].vp_addr >> page_shift);
+			PIN_ReleaseLock(&lfu_lock);
+		}
+		if (i < n) {				// the slow path, before anything queued after it
+			const Pagevec::Entry& e = pv.e[i++];
+			TierAccess(pv.owner, e.write ? WRITE_OP : READ_OP, e.code, e.vp_addr, e.pc);
+		}
+	}
+}
+
+// -privtier: the thread's own LRU, touched by the thread only.
+static void PrivateAccess(THREADID tid, uint64_t vp_addr)
+{
+	HashLL& l = *privTiers[tid];
+	StatPack& s = *stats[tid];
+	s.privAcc.fetch_add(1, std::memory_order_relaxed);
+	if (l.find_node(vp_addr)) s.privHits.fetch_add(1, std::memory_order_relaxed);
+	l.touch(vp_addr);
+}
+
+// A miss in every cache level goes to the page tiers.
+static void MemoryAccess(THREADID tid, UINT32 op, bool code, UINT64 vp_addr, uint64_t pc)
+{
+	vp_addr = PageAddr(vp_addr);
+	if (regionsOn) {
+		MEMREGIONS::Kind k = RegionKind(vp_addr);
+		stats[tid]->kindAcc[k][RK_ALL].fetch_add(1, std::memory_order_relaxed);
+		if (skipFilePages && MEMREGIONS::file_backed(k)) {	// page cache
+			stats[tid]->kindAcc[k][RK_SKIPPED].fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	if (privPages) PrivateAccess(tid, vp_addr);
+	if (damon) { DamonAccess(tid, code, vp_addr, pc); return; }
+	if (mapped_bits && mapped_bits->test(vp_addr >> page_shift)) {	// no fault
+		accessed_bits->set(vp_addr >> page_shift);
+		if (op == WRITE_OP) dirty_bits->set(vp_addr >> page_shift);
+		stats[tid]->mappedHits.fetch_add(1, std::memory_order_relaxed);
+		if (code) stats[tid]->mappedCode.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (!pagevecSize) { TierAccess(tid, op, code, vp_addr, pc); return; }
+
+	Pagevec& pv = *pagevecs[tid];
+	uint64_t now = stats[tid]->ins.load(std::memory_order_relaxed);
+	if (!pv.n) pv.first = now;
+	pv.e[pv.n++] = { vp_addr, pc, op == WRITE_OP, code };
+	if (pv.n >= pagevecSize || (pagevecIns && now - pv.first >= pagevecIns))
+		PagevecFlush(tid, pv);
+}
+
+// -----------------------------------------------------------------------
+// Prefetching (-pf_l1, -pf_l2). A unit's prefetcher trains on its demand
+// accesses under the unit lock; due prefetches are filled afterwards.
+// -----------------------------------------------------------------------
+typedef uint64_t PfReady[PREFETCH::Prefetcher::QUEUE];
+
+// Caller holds u->lock
+static size_t PrefetchTrain(CacheUnit* u, uint64_t pc, uint64_t line, bool hit, bool firstUse,
+							uint64_t* ready)
+{
+	if (!hit) u->pf.cancel(line);
+	uint64_t cand[PREFETCH::Prefetcher::MAX_DEGREE];
+	size_t k = u->pf.train(pc, line, !hit || firstUse, cand);
+	for (size_t j = 0; j < k; ++j)
+		if (!u->cache.Contains(cand[j])) u->pf.enqueue(cand[j]);
+	return u->pf.advance(ready);
+}
+
+// A prefetch lands in level `lvl`, fetched from the first level below
+// that has the line, or from memory, which feeds the page tiers like a
+// demand miss. Only the target level marks the line as prefetched.
+static void PrefetchFill(THREADID tid, size_t lvl, bool code, uint64_t line)
+{
+	if (coherence && !code && !levels[lvl].shared)
+		Cohere(tid, line, false, 0, 0, 0);
+
+	size_t n = levels.size(), src = n;
+	bool dirty = false;
+	for (size_t k = lvl; k < n; ++k) {
+		CacheUnit* u = Unit(k, tid, code);
+		PIN_GetLock(&u->lock, tid+1);
+		bool here = u->cache.Contains(line);
+		if (here && k > lvl && levels[k].incl == INCL_EXCLUSIVE)
+			u->cache.Invalidate(line, dirty);
+		PIN_ReleaseLock(&u->lock);
+		if (here) { src = k; break; }
+	}
+	if (src == lvl) return;					// arrived meanwhile
+
+	for (size_t i = src; i-- > lvl; ) {
+		if (i > lvl && levels[i].incl == INCL_EXCLUSIVE) continue;
+		CacheUnit* u = Unit(i, tid, code);
+		PIN_GetLock(&u->lock, tid+1);
+		SimpleCache::Victim v = u->cache.Fill(line, i == lvl && dirty, i == lvl);
+		PIN_ReleaseLock(&u->lock);
+		if (v.valid) Evicted(tid, i, code, v.addr, v.dirty);
+	}
+	if (src == n) {
+		++pf_memory[lvl];
+		MemoryAccess(tid, READ_OP, code, line, 0);
+	}
+}
+
+VOID CacheCall(THREADID tid, UINT32 op, UINT64 /*icount*/, UINT64 pc,
+               UINT64 blkAddr, UINT32 /*stk*/, bool /*isPT*/, int accType, UINT64 vp_addr)
+{
+	bool code  = accType == access_inst;
+	bool write = op == WRITE_OP;
+
+	// Look down the hierarchy until a level hits. A hit in an exclusive
+	// level moves the line up, so it leaves that level.
+	size_t n = levels.size(), hit = n;
+	bool carried = false;
+	PfReady ready[MAX_LEVELS];
+	size_t  nready[MAX_LEVELS] = {};
+	for (size_t i = 0; i < n; ++i) {
+		CacheUnit* u = Unit(i, tid, code);
+		PIN_GetLock(&u->lock, tid+1);
+		bool first = false;
+		bool h = u->cache.Lookup(blkAddr, write && i == 0, &first);
+		if (h && i > 0 && levels[i].incl == INCL_EXCLUSIVE)
+			u->cache.Invalidate(blkAddr, carried);
+		if (u->pf.active())
+			nready[i] = PrefetchTrain(u, pc, blkAddr, h, first, ready[i]);
+		PIN_ReleaseLock(&u->lock);
+		if (h) { hit = i; break; }
+	}
+
+	// Fill the levels that missed, lowest first, so a victim written back
+	// finds its copy below. Exclusive levels only take victims. Writes
+	// dirty L1 only (write-back caches).
+	for (size_t i = hit; i-- > 0; ) {
+		if (i > 0 && levels[i].incl == INCL_EXCLUSIVE) continue;
+		CacheUnit* u = Unit(i, tid, code);
+		PIN_GetLock(&u->lock, tid+1);
+		SimpleCache::Victim v = u->cache.Fill(blkAddr, i == 0 && (write || carried));
+		PIN_ReleaseLock(&u->lock);
+		if (v.valid) Evicted(tid, i, code, v.addr, v.dirty);
+	}
+
+	if (hit == n) MemoryAccess(tid, op, code, vp_addr, pc);	// missed every level
+
+	for (size_t i = 0; i < n; ++i)
+		for (size_t j = 0; j < nready[i]; ++j)
+			PrefetchFill(tid, i, code, ready[i][j]);
+}
+
+// -----------------------------------------------------------------------
+// Address translation (-tlb). The page-walk cache holds upper-level
+// entries, so a walk resumes below the deepest one it finds.
+// -----------------------------------------------------------------------
+static uint64_t PwcKey(uint32_t level, uint64_t vaddr)
+{
+	uint64_t va = vaddr & ((1ULL << 48) - 1);
+	return ((va >> TLBSIM::level_shift(level)) << 2) | level;
+}
+
+static void PageWalk(THREADID tid, uint64_t vaddr, bool huge)
+{
+	TLBSIM::Tlb& pwc = tlbs[tid]->pwc;
+	uint32_t leaf  = huge ? 3 : 4;
+	uint32_t start = 1;
+	for (uint32_t l = leaf - 1; l >= 1; --l) {
+		if (pwc.lookup(PwcKey(l, vaddr))) { start = l + 1; break; }
+	}
+
+	for (uint32_t l = start; l <= leaf; ++l) {
+		uint64_t pte = TLBSIM::pte_addr(PT_REGION, l, vaddr);
+		CacheCall(tid, READ_OP, 0, 0, pte & DATA_BLOCK_FLOOR_ADDR_MASK,
+				  0, true, access_page_table, pte);
+		if (l < leaf) pwc.insert(PwcKey(l, vaddr));
+	}
+	++page_walks;
+	walk_refs += leaf - start + 1;
+}
+
+static void Translate(THREADID tid, uint64_t vaddr, bool inst)
+{
+	bool huge = mixedPages && InHugeRange(vaddr);
+	uint64_t key = ((vaddr >> (huge ? 21 : page_shift)) << 1) | huge;
+
+	TLBSIM::Tlb& l1 = inst ? tlbs[tid]->itlb : tlbs[tid]->dtlb;
+	if (l1.lookup(key)) return;
+
+	PIN_GetLock(&stlbLock, tid+1);
+	bool hit = stlb->lookup(key);
+	if (!hit) stlb->insert(key);
+	PIN_ReleaseLock(&stlbLock);
+	l1.insert(key);
+
+	if (!hit) PageWalk(tid, vaddr, huge);
+}
+
+// -----------------------------------------------------------------------
+// Recording memory reads/writes
+// -----------------------------------------------------------------------
+VOID RecordMemRead(VOID* ip, VOID* addr, UINT32 size, UINT32 stk,
+                   ADDRINT rbp, ADDRINT rsp, THREADID tid)
+{
+	if (globalIns.load(std::memory_order_relaxed) <= fastForwardTo) return;
+	++uc_epoch;
+	++cl_epoch;
+
+    (void)ip; (void)rbp; (void)rsp; (void)stk;
+    stats[tid]->memIns.fetch_add(1, std::memory_order_relaxed);
+	stats[tid]->reads.fetch_add(1, std::memory_order_relaxed);
+	UINT64 vp_addr = (UINT64)addr;
+	if (tlbOn) Translate(tid, vp_addr, false);
+	UINT64 blk = ((UINT64)addr + CACHELINE_OFFSET) & DATA_BLOCK_FLOOR_ADDR_MASK;
+	if (coherence) Cohere(tid, blk, false, (UINT64)ip, vp_addr - blk, size);
+    CacheCall(tid, READ_OP, 0, (UINT64)ip, blk, stk, false, access_data, vp_addr);
+}
+
+VOID RecordMemWrite(VOID* ip, VOID* addr, UINT32 size, UINT32 stk,
+                    ADDRINT rbp, ADDRINT rsp, THREADID tid)
+{
+	if (globalIns.load(std::memory_order_relaxed) <= fastForwardTo) return;
+	++uc_epoch;
+	++cl_epoch;
+
+    (void)ip; (void)rbp; (void)rsp; (void)stk;
+    stats[tid]->memIns.fetch_add(1, std::memory_order_relaxed);
+	stats[tid]->writes.fetch_add(1, std::memory_order_relaxed);
+	UINT64 vp_addr = (UINT64)addr;
+	if (tlbOn) Translate(tid, vp_addr, false);
+	UINT64 blk = ((UINT64)addr + CACHELINE_OFFSET) & DATA_BLOCK_FLOOR_ADDR_MASK;
+	if (coherence) Cohere(tid, blk, true, (UINT64)ip, vp_addr - blk, size);
+    CacheCall(tid, WRITE_OP, 0, (UINT64)ip, blk, stk, false, access_data, vp_addr);
+}
+
+// -----------------------------------------------------------------------
+// Cost model: turn tier outcomes into time (in -lat_unit units).
+// Stall is everything spent below L2; the slowdown compares against the
+// same run with every L2 miss served as an uncompressed hit.
+// -----------------------------------------------------------------------
+struct TierCounts {
+	uint64_t ins=0, acc[MAX_LEVELS]={}, uncl=0, cl=0, cpage=0, promote=0, recomp=0;
+	uint64_t swapin=0, swap_stall=0;	// major faults and their latency
+
+	TierCounts operator-(const TierCounts& o) const {
+		TierCounts d = { ins - o.ins, {}, uncl - o.uncl, cl - o.cl, cpage - o.cpage,
+						 promote - o.promote, recomp - o.recomp,
+						 swapin - o.swapin, swap_stall - o.swap_stall };
+		for (size_t i = 0; i < MAX_LEVELS; ++i) d.acc[i] = acc[i] - o.acc[i];
+		return d;
+	}
+};
+static TierCounts lastCounts;	// snapshot at the previous interval report
+
+// Accesses and misses of a cache level, including exited threads' caches
+static void LevelStats(const CacheLevel& L, uint64_t& acc, uint64_t& miss)
+{
+	acc  = L.retiredAcc;
+	miss = L.retiredMiss;
+	for (auto* u : L.units)
+		if (u) { acc += u->cache.Accesses(); miss += u->cache.Misses(); }
+}
+
+// Prefetch issued, useful, late, useless and dropped counts
+static void UnitPfStats(const CacheUnit& u, uint64_t* pf)
+{
+	pf[0] = u.pf.issued();
+	pf[1] = u.cache.PfUseful();
+	pf[2] = u.pf.late();
+	pf[3] = u.cache.PfUseless();
+	pf[4] = u.pf.dropped();
+}
+
+static void LevelPfStats(const CacheLevel& L, uint64_t* pf)
+{
+	std::copy(L.retiredPf, L.retiredPf + 5, pf);
+	for (auto* u : L.units) {
+		if (!u) continue;
+		uint64_t p[5];
+		UnitPfStats(*u, p);
+		for (int k = 0; k < 5; ++k) pf[k] += p[k];
+	}
+}
+
+static TierCounts CurrentCounts(uint64_t ins)
+{
+	FoldThreadHits();
+	TierCounts c;
+	c.ins = ins;
+	for (size_t i = 0; i < levels.size(); ++i) {
+		uint64_t miss;
+		LevelStats(levels[i], c.acc[i], miss);
+	}
+	if (ifetch) {
+		uint64_t acc, miss;
+		LevelStats(l1i, acc, miss);
+		c.acc[0] += acc;
+	}
+	c.uncl    = unclist_access;
+	c.cl      = clist_access;
+	c.cpage   = cpage_access;
+	c.promote = promotions;
+	c.recomp  = recompressions;
+	if (swapdev) {
+		PIN_GetLock(&swap_lock, 0);
+		c.swapin     = swapdev->stats().reads;
+		c.swap_stall = (uint64_t)swapdev->stats().stall;
+		PIN_ReleaseLock(&swap_lock);
+	}
+	return c;
+}
+
+static void ReportCost(const TierCounts& c)
+{
+	double hits  = 0;
+	for (size_t i = 0; i < MAX_LEVELS; ++i) hits += c.acc[i] * cost.lvl[i];
+	double stall = c.uncl * cost.uncl + c.cl * cost.cl
+				 + c.cpage * cost.cpage + c.promote * cost.promote
+				 + c.recomp * cost.recomp + c.swap_stall;
+	double ideal = (c.uncl + c.cl + c.cpage + c.swapin) * cost.uncl;
+	double base  = c.ins * cost.base_cpi;
+
+	Out << "\n  Est. page-tier stall: " << std::fixed << std::setprecision(0)
+		<< stall << ' ' << KnobLatUnit.Value()
+		<< "\n  Est. AMAT: " << std::setprecision(3)
+		<< (c.acc[0] ? (hits + stall) / c.acc[0] : 0.0) << ' ' << KnobLatUnit.Value()
+		<< "\n  Projected slowdown: " << std::setprecision(4)
+		<< ((base + hits + ideal) > 0 ? (base + hits + stall) / (base + hits + ideal) : 1.0)
+		<< "x\n";
+}
+
+static void IntervalReport(uint64_t cur)
+{
+	// -------- per cache level --------
+	Out << "\n[Report @ " << cur << " instructions]\n";
+	for (auto& L : levels) {
+		uint64_t acc, miss;
+		LevelStats(L, acc, miss);
+		Out << "  " << L.name << " accesses : " << acc
+			<< "\n  misses: "     << miss
+			<< "\n  MPKI: "       << std::fixed << std::setprecision(2)
+			<< (cur ? 1000.0 * miss / cur : 0.0) << '\n';
+	}
+
+	// -------- print report --------
+	TierCounts now = CurrentCounts(cur);
+	Out		<< "\n  Clist Accesses: " << clist_access
+			<< "\n  Unclist Accesses: " << unclist_access
+			<< "\n  Cpage   Accesses: " << cpage_access
+			<< "\n  Promotions: " << promotions
+			<< "\n  Recompressions: " << recompressions;
+	if (damon)
+		Out << "\n  DAMON region moves: " << damon_promoted << " pages up into unclist, "
+			<< damon_demoted << " down";
+	if (swapdev)
+		Out << "\n  Swap faults: " << now.swapin;
+	if (unclpct > 0 || clpct > 0)
+		Out << "\n  App RSS: " << (rss_app >> page_shift) << " pages"
+			<< " (unclist cap " << unclist->get_cap()
+			<< ", clist cap " << clist->get_cap() << ")";
+
+	// -------- cost of this interval --------
+	ReportCost(now - lastCounts);
+	lastCounts = now;
+}
+
+// -----------------------------------------------------------------------
+// Zero this process's counters (cache stats, tier outcomes, instruction
+// stats). Page-list access counts are shared state and left alone.
+// -----------------------------------------------------------------------
+static void ResetStats(uint64_t ins)
+{
+	auto resetLevel = [](CacheLevel& L) {
+		for (auto* u : L.units)
+		{
+			if (u)
+			{
+				u->cache.ResetStats();
+				u->pf.reset_stats();
+			}
+		}
+		L.retiredAcc = L.retiredMiss = 0;
+		std::fill(L.retiredPf, L.retiredPf + 5, 0);
+	};
+	for (auto& L : levels) resetLevel(L);
+	resetLevel(l1i);
+	back_invalidations = 0;
+	FoldThreadHits();	// and drop them with the rest
+	for (auto& m : pf_memory) m = 0;
+
+	clist_access	= 0;
+	unclist_access	= 0;
+	cpage_access	= 0;
+	promotions		= 0;
+	recompressions	= 0;
+	dirty_writebacks= 0;
+	clist_writebacks= 0;
+	code_unclist_access	= 0;
+	code_clist_access	= 0;
+	code_cpage_access	= 0;
+	if (swapdev) {
+		PIN_GetLock(&swap_lock, 0);
+		swapdev->reset_stats();
+		PIN_ReleaseLock(&swap_lock);
+	}
+	if (shadows[TIER_UNCL]) {
+		PIN_GetLock(&shadow_lock, 0);
+		for (auto* t : shadows) t->reset_stats();
+		PIN_ReleaseLock(&shadow_lock);
+	}
+	lfu_rejects			= 0;
+	lfu_promote_rejects	= 0;
+	pagevec_flushes		= 0;
+	pagevec_batched		= 0;
+	scans = scan_pages = scan_young = scan_hits = 0;
+	damon_promoted = damon_demoted = 0;
+	for (auto& t : share_acc)
+		for (auto& n : t) n.store(0, std::memory_order_relaxed);
+	for (auto * t : tlbs) {
+		if (t) { t->dtlb.reset_stats(); t->itlb.reset_stats(); t->pwc.reset_stats(); }
+	}
+	if (stlb) stlb->reset_stats();
+	std::fill(&tlbRetired[0][0], &tlbRetired[0][0] + 6, 0);
+	page_walks	= 0;
+	walk_refs	= 0;
+	coh_upgrades = coh_invalidations = coh_downgrades = coh_writebacks = 0;
+	coh_misses = coh_false = 0;
+	for (size_t i = 0; coherence && i < DIR_SHARDS; ++i) {
+		PIN_GetLock(&dirShards[i].lock, 0);
+		dirShards[i].byLine.clear();
+		dirShards[i].byPC.clear();
+		PIN_ReleaseLock(&dirShards[i].lock);
+	}
+	for (auto& sptr : stats) {
+		if (sptr) {
+			sptr->ins   .store(0, std::memory_order_relaxed);
+			sptr->memIns.store(0, std::memory_order_relaxed);
+			sptr->reads .store(0, std::memory_order_relaxed);
+			sptr->writes.store(0, std::memory_order_relaxed);
+			for (auto& k : sptr->kindAcc)
+				for (auto& n : k) n.store(0, std::memory_order_relaxed);
+			sptr->privAcc .store(0, std::memory_order_relaxed);
+			sptr->privHits.store(0, std::memory_order_relaxed);
+		}
+	}
+	lastCounts		= TierCounts{};
+	lastCounts.ins	= ins;
+}
+
+// -----------------------------------------------------------------------
+// Checkpoint/restore. The file holds fixed-size records only (see ckpt.h):
+// the geometry it was taken with, counters, every cache line, and both page
+// lists from MRU to LRU.
+// -----------------------------------------------------------------------
+enum : uint32_t { CK_CONFIG = 1, CK_COUNTERS, CK_CACHE, CK_CACHESTATS, CK_UNCLIST, CK_CLIST,
+				  CK_SWAP, CK_SHADOW, CK_SKETCH };
+
+// Caches are keyed (level << 16 | unit); L1I is level CK_L1I.
+constexpr uint32_t CK_L1I = MAX_LEVELS;
+
+struct CkConfig {
+	uint64_t size[MAX_LEVELS + 1];
+	uint32_t assoc[MAX_LEVELS + 1];
+	uint32_t blk, page_shift, cores;
+	uint8_t  shared[MAX_LEVELS + 1], incl[MAX_LEVELS + 1];
+	char     policy[16];
+	uint8_t  swap;
+};
+
+struct CkCounters {
+	uint64_t ins, stats[4];				// ins, memIns, reads, writes
+	uint64_t retired[MAX_LEVELS + 1][2];	// exited threads' acc, miss
+	uint64_t clist_access, unclist_access, cpage_access, promotions;
+	uint64_t dirty_writebacks, clist_writebacks, recompressions;
+	uint64_t est_computed, est_reused, est_kind[4], clist_byte_evictions;
+	uint64_t uc_epoch, cl_epoch, lastReportIns;
+	uint64_t code_unclist_access, code_clist_access, code_cpage_access;
+	SWAPDEV::Stats swap;
+	SHADOW::Histogram refaults[2];		// by tier
+	uint64_t shadow_evictions[2], shadow_dropped[2];
+	uint64_t lfu_rejects, lfu_promote_rejects, lfu_sampled;
+	uint64_t pagevec_flushes, pagevec_batched;
+	uint64_t scans, scan_pages, scan_young, scan_hits;
+	uint64_t damon_promoted, damon_demoted;
+	TierCounts last;
+};
+
+struct CkPage {
+	uint64_t vp_num, access_count;
+	uint32_t csize, writes;
+	uint8_t  dirty, code, stale, pad;
+	uint32_t sharers;
+};
+
+struct CkSwap {
+	uint64_t vp_num;
+	uint32_t bytes, pad;
+};
+
+struct CkShadow {
+	uint64_t vp_num;
+	uint32_t age, pad;
+};
+
+static CacheLevel* CkLevel(uint32_t id)
+{
+	if (id < levels.size()) return &levels[id];
+	return (id == CK_L1I && ifetch) ? &l1i : nullptr;
+}
+
+static CkConfig CurrentConfig()
+{
+	CkConfig c;
+	std::memset(&c, 0, sizeof(c));
+	for (uint32_t id = 0; id <= CK_L1I; ++id) {
+		CacheLevel* L = CkLevel(id);
+		if (!L) continue;
+		c.size[id]   = L->cfg.sizeBytes;
+		c.assoc[id]  = L->cfg.ways;
+		c.shared[id] = L->shared;
+		c.incl[id]   = L->incl;
+	}
+	c.blk        = KnobBlkBytes.Value();
+	c.page_shift = page_shift;
+	c.cores      = cores;
+	std::strncpy(c.policy, tiers->name(), sizeof(c.policy) - 1);
+	c.swap       = swapdev != nullptr;
+	return c;
+}
+
+static std::vector<CkPage> PageRecords(const HashLL& list)
+{
+	std::vector<CkPage> recs;
+	recs.reserve(list.get_size());
+	list.for_each([&](const HashLL::hash_node& n){
+		recs.push_back({ n.vp_num, n.access_count, n.csize, n.writes, n.dirty, n.code, n.stale, 0, n.sharers });
+	});
+	return recs;
+}
+
+// Other application threads must be stopped; internal threads may still
+// resize the lists, so those are read under their locks.
+static bool WriteCheckpoint(THREADID tid, uint64_t cur)
+{
+	CKPT::Writer w;
+	CkConfig cfg = CurrentConfig();
+	w.add(CK_CONFIG, 0, &cfg, sizeof(cfg));
+
+	FoldThreadHits();
+	CkCounters c = {};
+	c.ins = cur;
+	for (auto& s : stats) {
+		if (s) {
+			c.stats[0] += s->ins	.load(std::memory_order_relaxed);
+			c.stats[1] += s->memIns.load(std::memory_order_relaxed);
+			c.stats[2] += s->reads	.load(std::memory_order_relaxed);
+			c.stats[3] += s->writes.load(std::memory_order_relaxed);
+		}
+	}
+	for (uint32_t id = 0; id <= CK_L1I; ++id) {
+		if (CacheLevel* L = CkLevel(id)) {
+			c.retired[id][0] = L->retiredAcc;
+			c.retired[id][1] = L->retiredMiss;
+		}
+	}
+	c.clist_access		= clist_access;
+	c.unclist_access	= unclist_access;
+	c.cpage_access		= cpage_access;
+	c.promotions		= promotions;
+	c.dirty_writebacks	= dirty_writebacks;
+	c.clist_writebacks	= clist_writebacks;
+	c.recompressions	= recompressions;
+	c.est_computed		= est_computed;
+	c.est_reused		= est_reused;
+	std::copy(est_kind, est_kind + 4, c.est_kind);
+	c.clist_byte_evictions = clist_byte_evictions;
+	c.uc_epoch			= uc_epoch;
+	c.cl_epoch			= cl_epoch;
+	c.lastReportIns		= lastReportIns;
+	c.code_unclist_access	= code_unclist_access;
+	c.code_clist_access		= code_clist_access;
+	c.code_cpage_access		= code_cpage_access;
+	if (swapdev) c.swap		= swapdev->stats();
+	c.pagevec_flushes		= pagevec_flushes;
+	c.pagevec_batched		= pagevec_batched;
+	c.scans					= scans;
+	c.scan_pages			= scan_pages;
+	c.scan_young			= scan_young;
+	c.scan_hits				= scan_hits;
+	c.damon_promoted		= damon_promoted;
+	c.damon_demoted			= damon_demoted;
+	c.lfu_rejects			= lfu_rejects;
+	c.lfu_promote_rejects	= lfu_promote_rejects;
+	std::vector<uint64_t> sketch[2];
+	if (lfu) {
+		PIN_GetLock(&lfu_lock, tid+1);
+		c.lfu_sampled = lfu->sampled();
+		sketch[0] = lfu->counters();
+		sketch[1] = lfu->doorkeeper();
+		PIN_ReleaseLock(&lfu_lock);
+	}
+	std::vector<CkShadow> sh[2];
+	if (shadows[TIER_UNCL]) {
+		PIN_GetLock(&shadow_lock, tid+1);
+		for (int t = 0; t < 2; ++t) {
+			c.refaults[t]			= shadows[t]->histogram();
+			c.shadow_evictions[t]	= shadows[t]->evictions();
+			c.shadow_dropped[t]		= shadows[t]->dropped();
+			shadows[t]->for_each([&](uint64_t vp, uint32_t age){ sh[t].push_back({ vp, age, 0 }); });
+		}
+		PIN_ReleaseLock(&shadow_lock);
+	}
+	c.last				= lastCounts;
+	w.add(CK_COUNTERS, 0, &c, sizeof(c));
+
+	std::vector<Line> lines;
+	for (uint32_t id = 0; id <= CK_L1I; ++id) {
+		CacheLevel* L = CkLevel(id);
+		if (!L) continue;
+		for (size_t o = 0; o < L->units.size(); ++o) {
+			CacheUnit* u = L->units[o];
+			if (!u) continue;
+			lines.clear();
+			PIN_GetLock(&u->lock, tid+1);
+			u->cache.Export(lines);
+			uint64_t st[2] = { u->cache.Accesses(), u->cache.Misses() };
+			PIN_ReleaseLock(&u->lock);
+			w.add(CK_CACHE, id << 16 | o, lines);
+			w.add(CK_CACHESTATS, id << 16 | o, st, sizeof(st));
+		}
+	}
+
+	unc_lock.Get(tid);
+	w.add(CK_UNCLIST, 0, PageRecords(*unclist));
+	unc_lock.Release();
+	c_lock.Get(tid);
+	w.add(CK_CLIST, 0, PageRecords(*clist));
+	c_lock.Release();
+	if (swapdev) {
+		std::vector<CkSwap> sw;
+		PIN_GetLock(&swap_lock, tid+1);
+		swapdev->for_each([&](uint64_t vp, uint32_t bytes){ sw.push_back({ vp, bytes, 0 }); });
+		PIN_ReleaseLock(&swap_lock);
+		w.add(CK_SWAP, 0, sw);
+	}
+	if (shadows[TIER_UNCL])
+		for (int t = 0; t < 2; ++t) w.add(CK_SHADOW, t, sh[t]);
+	if (lfu)
+		for (int k = 0; k < 2; ++k) w.add(CK_SKETCH, k, sketch[k]);
+
+	return w.write(KnobCheckpointFile.Value().c_str());
+}
+
+// Called by the one thread that claimed checkpointAt (set to 0) once the
+// count reached it. If some other thread is stopping us, put it back so
+// the next instruction on any thread tries again.
+static void TakeCheckpoint(THREADID tid, uint64_t cur)
+{
+	if (!PIN_StopApplicationThreads(tid)) {
+		checkpointAt = cur;
+		return;
+	}
+	for (auto* pv : pagevecs)	// the other threads are stopped
+		if (pv) PagevecFlush(tid, *pv);
+	bool ok = WriteCheckpoint(tid, cur);
+	PIN_ResumeApplicationThreads(tid);
+
+	Out << "\n[Checkpoint @ " << cur << " instructions] "
+		<< (ok ? "written to " : "FAILED writing ") << KnobCheckpointFile.Value() << '\n';
+}
+
+// Refill a list from MRU to LRU, stopping where the current run's page cap
+// or byte budget is smaller than the one the checkpoint came from.
+static void RestoreList(HashLL& list, const CkPage* p, uint64_t n)
+{
+	for (uint64_t i = 0; i < n && !list.isFull(); ++i) {
+		if (cmodel && list.get_byte_cap() &&
+			list.get_used_bytes() + p[i].csize > list.get_byte_cap())
+			break;
+		uint64_t addr = p[i].vp_num << page_shift;
+		list.insert_lru(addr);
+		auto node = list.find_node(addr);
+		node->access_count = p[i].access_count;
+		node->writes       = p[i].writes;
+		node->dirty        = p[i].dirty;
+		node->code         = p[i].code;
+		node->stale        = p[i].stale;
+		node->sharers      = p[i].sharers;
+		if (cmodel && p[i].csize) list.set_csize(addr, p[i].csize);
+	}
+}
+
+static bool RestoreCheckpoint(const std::string& path)
+{
+	CKPT::Reader r;
+	if (!r.open(path.c_str())) {
+		std::cerr << "Cannot read checkpoint " << path << '\n';
+		return false;
+	}
+
+	uint64_t n;
+	CkConfig want = CurrentConfig();
+	auto cfg = r.find<CkConfig>(CK_CONFIG, 0, n);
+	if (!cfg || n != 1 || std::memcmp(cfg, &want, sizeof(want)) != 0) {
+		std::cerr << "Checkpoint " << path
+				  << " was taken with a different cache, page geometry or -policy\n";
+		return false;
+	}
+
+	auto c = r.find<CkCounters>(CK_COUNTERS, 0, n);
+	if (!c) {
+		std::cerr << "Checkpoint " << path << " is incomplete\n";
+		return false;
+	}
+
+	// Shared and per-core caches are filled now, per-thread ones as their
+	// threads start
+	for (uint32_t key : r.keys(CK_CACHE)) {
+		CacheLevel* L = CkLevel(key >> 16);
+		uint64_t nl, ns;
+		auto lines = r.find<Line>(CK_CACHE, key, nl);
+		auto st    = r.find<uint64_t>(CK_CACHESTATS, key, ns);
+		if (!L || nl != L->cfg.sizeBytes / L->cfg.blockBytes || ns != 2) continue;
+		CacheUnit* u = L->shared ? L->units[0]
+					 : cores && (key & 0xffff) < cores ? L->units[key & 0xffff] : nullptr;
+		if (u) {
+			if (L->shared || !coherence) u->cache.Import(lines);	// see ThreadStart
+			u->cache.SetStats(st[0], st[1]);
+		} else {
+			RestoredUnit& ru = restoredUnits[key];
+			ru.lines.assign(lines, lines + nl);
+			ru.acc  = st[0];
+			ru.miss = st[1];
+		}
+	}
+	for (uint32_t id = 0; id <= CK_L1I; ++id) {
+		if (CacheLevel* L = CkLevel(id)) {
+			L->retiredAcc  = c->retired[id][0];
+			L->retiredMiss = c->retired[id][1];
+		}
+	}
+
+	auto u = r.find<CkPage>(CK_UNCLIST, 0, n);
+	RestoreList(*unclist, u, n);
+	tiers->restored();
+	auto cl = r.find<CkPage>(CK_CLIST, 0, n);
+	RestoreList(*clist, cl, n);
+	if (swapdev) {
+		auto sw = r.find<CkSwap>(CK_SWAP, 0, n);
+		for (uint64_t i = 0; sw && i < n; ++i) swapdev->restore(sw[i].vp_num, sw[i].bytes);
+		swapdev->set_stats(c->swap);
+	}
+	if (lfu) {	// a sketch of another size is left cold
+		uint64_t nt, nd;
+		auto t = r.find<uint64_t>(CK_SKETCH, 0, nt);
+		auto d = r.find<uint64_t>(CK_SKETCH, 1, nd);
+		if (t && d) lfu->load(t, nt, d, nd, c->lfu_sampled);
+	}
+	pagevec_flushes			= c->pagevec_flushes;
+	pagevec_batched			= c->pagevec_batched;
+	scans					= c->scans;
+	scan_pages				= c->scan_pages;
+	scan_young				= c->scan_young;
+	scan_hits				= c->scan_hits;
+	damon_promoted			= c->damon_promoted;
+	damon_demoted			= c->damon_demoted;
+	lfu_rejects				= c->lfu_rejects;
+	lfu_promote_rejects		= c->lfu_promote_rejects;
+	for (int t = 0; shadows[TIER_UNCL] && t < 2; ++t) {
+		auto sh = r.find<CkShadow>(CK_SHADOW, t, n);
+		for (uint64_t i = 0; sh && i < n; ++i) shadows[t]->restore(sh[i].vp_num, sh[i].age);
+		shadows[t]->set_state(c->shadow_evictions[t], c->shadow_dropped[t], c->refaults[t]);
+	}
+
+	std::copy(c->stats, c->stats + 4, restoredStats);
+	clist_access			= c->clist_access;
+	unclist_access			= c->unclist_access;
+	cpage_access			= c->cpage_access;
+	promotions				= c->promotions;
+	dirty_writebacks		= c->dirty_writebacks;
+	clist_writebacks		= c->clist_writebacks;
+	recompressions			= c->recompressions;
+	est_computed			= c->est_computed;
+	est_reused				= c->est_reused;
+	std::copy(c->est_kind, c->est_kind + 4, est_kind);
+	clist_byte_evictions	= c->clist_byte_evictions;
+	uc_epoch				= c->uc_epoch;
+	cl_epoch				= c->cl_epoch;
+	lastReportIns			= c->lastReportIns;
+	code_unclist_access		= c->code_unclist_access;
+	code_clist_access		= c->code_clist_access;
+	code_cpage_access		= c->code_cpage_access;
+	lastCounts				= c->last;
+	fastForwardTo			= c->ins;
+
+	Out << "[Restored from " << path << " @ " << c->ins << " instructions]\n";
+	return true;
+}
+
+// -----------------------------------------------------------------------
+// Thread-to-core scheduling (-cores, -sched)
+// -----------------------------------------------------------------------
+static uint32_t PickCore(THREADID tid)
+{
+	switch (sched) {
+	case CORE_RR:		 return rrNext.fetch_add(1) % cores;
+	case CORE_AFFINITY: {
+		int cpu = sched_getcpu();
+		return cpu < 0 ? tid % cores : (uint32_t)cpu % cores;
+	}
+	default:			 return tid % cores;
+	}
+}
+
+// Affinity scheduling follows the real thread around. Caches stay with
+// their core, so a migrated thread starts cold on its new one.
+static void Resample(THREADID tid, uint64_t ins)
+{
+	CoreMap& m = coreMap[tid];
+	m.resample = ins + KnobResched.Value();
+	uint32_t core = PickCore(tid);
+	if (core != m.core) {
+		m.core = core;
+		++migrations;
+	}
+}
+
+// -----------------------------------------------------------------------
+// Instrumentation functions
+// -----------------------------------------------------------------------
+
+// One call per basic block: fetch each line the block spans
+VOID RecordFetch(ADDRINT addr, UINT32 size, THREADID tid)
+{
+	if (globalIns.load(std::memory_order_relaxed) <= fastForwardTo) return;
+
+	UINT64 lastPage = MAXVAL;
+	for (UINT64 blk = addr & DATA_BLOCK_FLOOR_ADDR_MASK; blk < addr + size;
+		 blk += KnobBlkBytes.Value()) {
+		if (tlbOn && (blk >> page_shift) != lastPage) {
+			Translate(tid, blk, true);
+			lastPage = blk >> page_shift;
+		}
+		++uc_epoch;
+		++cl_epoch;
+		CacheCall(tid, READ_OP, 0, addr, blk, 0, false, access_inst, blk);
+	}
+}
+
+VOID Trace(TRACE trace, VOID*)
+{
+	for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+		BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)RecordFetch,
+			IARG_ADDRINT, BBL_Address(bbl), IARG_UINT32, BBL_Size(bbl),
+			IARG_THREAD_ID, IARG_END);
+}
+
+VOID Instruction(INS ins, VOID*)
+{
+    UINT32 stkStatus = 0;                 // could refine with REG_RSP vs REG_RBP
+
+    if(INS_IsMemoryRead(ins))
+        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMemRead,
+            IARG_INST_PTR, IARG_MEMORYREAD_EA, IARG_MEMORYREAD_SIZE, IARG_UINT32, stkStatus,
+            IARG_REG_VALUE, REG_RBP, IARG_REG_VALUE, REG_RSP,
+            IARG_THREAD_ID, IARG_END);
+
+    if(INS_IsMemoryWrite(ins))
+        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)RecordMemWrite,
+            IARG_INST_PTR, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_UINT32, stkStatus,
+            IARG_REG_VALUE, REG_RBP, IARG_REG_VALUE, REG_RSP,
+            IARG_THREAD_ID, IARG_END);
+
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)+[](THREADID tid){
+		uint64_t cur  = ++globalIns;                       // total instructions
+		if (cur <= fastForwardTo) return;                  // before the restore point
+		uint64_t mine = stats[tid]->ins.fetch_add(1, std::memory_order_relaxed) + 1;
+		if (sched == CORE_AFFINITY && cores && KnobResched.Value() && mine >= coreMap[tid].resample)
+			Resample(tid, mine);
+		uint64_t ck = checkpointAt.load(std::memory_order_relaxed);
+		if (ck && cur >= ck && checkpointAt.compare_exchange_strong(ck, 0))
+			TakeCheckpoint(tid, cur);
+		if (pagevecSize && pagevecIns) {		// flush a stale batch
+			Pagevec* pv = pagevecs[tid];
+			if (pv && pv->n && mine - pv->first >= pagevecIns) PagevecFlush(tid, *pv);
+		}
+		if (scanEvery) {
+			uint64_t at = scanAt.load(std::memory_order_relaxed);
+			if (cur >= at && scanAt.compare_exchange_strong(at, cur + scanEvery))
+				PIN_SemaphoreSet(&scanSem);	// wake the scanner
+		}
+		if (damonEvery) {
+			uint64_t at = damonAt.load(std::memory_order_relaxed);
+			if (cur >= at && damonAt.compare_exchange_strong(at, cur + damonEvery))
+				PIN_SemaphoreSet(&damonSem);	// next sample
+		}
+		uint64_t last = lastReportIns.load(std::memory_order_relaxed);
+		if ((cur - last) > MAX_INTERVAL)
+		{
+			// let **one** thread do the report
+			if (lastReportIns.compare_exchange_strong(last, cur))
+			{
+				/* 
+					Maybe locking is needed here? At the very least check
+					In any case, this is where we will also flush out all
+					counters for both clist and unclist accesses.
+					LRU order is preserved, we just want to record and 
+					prevent an integer overflow. 
+					I guess flushing is not needed if we just use a uint64.
+					Maybe flush just in case? Not sure we'll ever hit that
+					cap but it wouldn't hurt to be sure. God knows how many
+					instructions are present in a seven-to-ten hour benchmark.
+				 */
+				IntervalReport(cur);
+
+				// Statistics reset occurs here:
+				PIN_GetLock(&reset_lock, tid+1);
+				unclist->reset_counters();
+				clist->reset_counters();
+				ResetStats(cur);
+				PIN_ReleaseLock(&reset_lock);
+			}
+		}
+		else if ((cur - last) > REPORT_INTERVAL)
+		{
+			// let **one** thread do the report
+			if (lastReportIns.compare_exchange_strong(last, cur))
+			{
+				IntervalReport(cur);
+			}
+		}
+	}, IARG_THREAD_ID, IARG_END);
+}
+
+// -----------------------------------------------------------------------
+// Per-PC report (-pcstats). Thread tables are merged, then grouped by
+// function and by source line; the top -pcstats of each are listed by
+// total. Symbols come from RTN_FindNameByAddress and
+// PIN_GetSourceLocation, so lines need the application's debug info.
+// -----------------------------------------------------------------------
+// Function name and "file:line" of pc. Caller holds the client lock.
+static void CodeLocation(uint64_t pc, std::string& fn, std::string& where)
+{
+	fn = RTN_FindNameByAddress(pc);
+	if (fn.empty()) fn = "??";
+	INT32 line = 0;
+	std::string file;
+	PIN_GetSourceLocation(pc, nullptr, &line, &file);
+	where = file.empty() ? fn + " (no line info)" : file + ":" + decstr(line);
+}
+
+// Caller holds pc_lock.
+static void RetirePcTable(const PcTable& t)
+{
+	for (auto& e : t)
+		for (int k = 0; k < PC_KINDS; ++k) pcRetired[e.first].n[k] += e.second.n[k];
+}
+
+static void PcTopReport(const char* title, const std::unordered_map<std::string, PcCounts>& by)
+{
+	auto total = [](const PcCounts& c) { return c.n[PC_CLIST] + c.n[PC_CPAGE] + c.n[PC_PROMOTE]; };
+	std::vector<std::pair<uint64_t, const std::string*>> order;
+	for (auto& e : by) order.push_back({ total(e.second), &e.first });
+	std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, const std::string*>& a,
+											 const std::pair<uint64_t, const std::string*>& b) {
+		return a.first != b.first ? a.first > b.first : *a.second < *b.second; });
+
+	Out << "\n    " << std::left << std::setw(48) << title << std::right
+		<< std::setw(12) << "clist" << std::setw(12) << "cpage" << std::setw(12) << "promote";
+	for (size_t i = 0; i < order.size() && i < pcTop; ++i) {
+		const PcCounts& c = by.at(*order[i].second);
+		std::string name = *order[i].second;
+		if (name.size() > 47) name = "..." + name.substr(name.size() - 44);
+		Out << "\n    " << std::left << std::setw(48) << name << std::right
+			<< std::setw(12) << c.n[PC_CLIST] << std::setw(12) << c.n[PC_CPAGE]
+			<< std::setw(12) << c.n[PC_PROMOTE];
+	}
+	Out << '\n';
+}
+
+static void PcReport()
+{
+	PIN_GetLock(&pc_lock, 0);
+	for (auto*& t : pcTables) {
+		if (!t) continue;
+		RetirePcTable(*t);
+		delete t;
+		t = nullptr;
+	}
+
+	std::unordered_map<std::string, PcCounts> byFn, byLine;
+	PIN_LockClient();
+	for (auto& e : pcRetired) {
+		std::string fn, where;
+		CodeLocation(e.first, fn, where);
+		for (int k = 0; k < PC_KINDS; ++k) {
+			byFn[fn].n[k]		+= e.second.n[k];
+			byLine[where].n[k]	+= e.second.n[k];
+		}
+	}
+	PIN_UnlockClient();
+
+	Out << "\n  Page-tier misses by code (-pcstats " << pcTop << "): "
+		<< pcRetired.size() << " instructions";
+	PcTopReport("function", byFn);
+	PcTopReport("source line", byLine);
+	PIN_ReleaseLock(&pc_lock);
+}
+
+// -----------------------------------------------------------------------
+// Allocation-site report (-allocsites). Each page in a tier credits the
+// sites of the live blocks it overlaps with the overlapping bytes; a
+// site's live bytes in neither list are cold. Sites are listed by bytes
+// outside unclist, the candidates for compression or madvise. -damon keeps
+// no page lists, so only live bytes and cpage accesses are shown.
+// -----------------------------------------------------------------------
+static void AllocReport()
+{
+	struct Row { uint64_t site, tier[2]; };
+	std::unordered_map<uint64_t, Row> rows;
+	PIN_GetLock(&alloc_lock, 0);
+	HashLL* lists[2] = { unclist, clist };
+	for (int t = 0; t < 2; ++t) {
+		lists[t]->for_each([&](const HashLL::hash_node& n) {
+			uint64_t lo = n.vp_num << page_shift, hi = lo + PageBytes(lo);
+			auto it = allocs.upper_bound(lo);
+			if (it != allocs.begin() && std::prev(it)->second.hi > lo) --it;
+			for (; it != allocs.end() && it->first < hi; ++it) {
+				uint64_t a = std::max(lo, it->first), b = std::min(hi, it->second.hi);
+				if (a >= b) continue;
+				Row& r = rows[it->second.site];
+				r.site = it->second.site;
+				r.tier[t] += b - a;
+			}
+		});
+	}
+
+	std::vector<std::pair<uint64_t, uint64_t>> order;	// (bytes outside unclist, site)
+	uint64_t live = 0, bytes = 0;
+	for (auto& e : allocSites) {
+		live  += e.second.live;
+		bytes += e.second.live_bytes;
+		uint64_t uncl = rows.count(e.first) ? rows[e.first].tier[TIER_UNCL] : 0;
+		uint64_t out  = e.second.live_bytes > uncl ? e.second.live_bytes - uncl : 0;
+		if (out || e.second.cpage) order.push_back({ out, e.first });
+	}
+	std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, uint64_t>& a,
+											 const std::pair<uint64_t, uint64_t>& b) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second; });
+
+	Out << "\n  Allocation sites (-allocsites " << allocTop << "): " << allocSites.size()
+		<< " sites, " << live << " live blocks, " << bytes << " live bytes"
+		<< "\n    " << std::left << std::setw(40) << "site" << std::right
+		<< std::setw(8) << "blocks" << std::setw(14) << "live bytes";
+	if (!damon) Out << std::setw(14) << "unclist" << std::setw(14) << "clist" << std::setw(14) << "cold";
+	Out << std::setw(12) << "cpage";
+	PIN_LockClient();
+	for (size_t i = 0; i < order.size() && i < allocTop; ++i) {
+		const AllocSite& s = allocSites[order[i].second];
+		uint64_t uncl = 0, cl = 0;
+		auto r = rows.find(order[i].second);
+		if (r != rows.end()) { uncl = r->second.tier[TIER_UNCL]; cl = r->second.tier[TIER_CL]; }
+		std::string fn, where;
+		CodeLocation(order[i].second, fn, where);
+		if (where.size() > 39) where = "..." + where.substr(where.size() - 36);
+		Out << "\n    " << std::left << std::setw(40) << where << std::right
+			<< std::setw(8) << s.live << std::setw(14) << s.live_bytes;
+		if (!damon)
+			Out << std::setw(14) << uncl << std::setw(14) << cl
+				<< std::setw(14) << (s.live_bytes > uncl + cl ? s.live_bytes - uncl - cl : 0);
+		Out << std::setw(12) << s.cpage;
+	}
+	PIN_UnlockClient();
+	PIN_ReleaseLock(&alloc_lock);
+	Out << '\n';
+}
+
+// Page-tier accesses and occupancy by memory region (-regions). unclist
+// accesses are what is left of a kind's accesses after clist, cpage and
+// skipped ones, so with -swap they include swap-ins. Occupancy is left out
+// under -damon, which keeps no page lists.
+static void RegionReport()
+{
+	using namespace MEMREGIONS;
+	uint64_t acc[KINDS][RK_COUNTS] = {}, pages[KINDS][2] = {};
+	for (auto& s : stats)
+		for (int k = 0; s && k < KINDS; ++k)
+			for (int c = 0; c < RK_COUNTS; ++c)
+				acc[k][c] += s->kindAcc[k][c].load(std::memory_order_relaxed);
+	HashLL* lists[2] = { unclist, clist };
+	PIN_RWMutexReadLock(&regionLock);
+	for (int t = 0; t < 2; ++t)
+		lists[t]->for_each([&](const HashLL::hash_node& n) {
+			++pages[memRegions.kind_of(n.vp_num << page_shift)][t]; });
+	size_t ranges = memRegions.size();
+	PIN_RWMutexUnlock(&regionLock);
+
+	Out << "\n  Memory regions (-regions" << (skipFilePages ? ", -filepages skip" : "") << "): "
+		<< ranges << " ranges"
+		<< "\n    " << std::left << std::setw(8) << "region" << std::right
+		<< std::setw(14) << "accesses" << std::setw(14) << "unclist" << std::setw(12) << "clist"
+		<< std::setw(12) << "cpage" << std::setw(12) << "skipped";
+	if (!damon) Out << std::setw(14) << "unclist pages" << std::setw(12) << "clist pages";
+	for (int k = 0; k < KINDS; ++k) {
+		const uint64_t* a = acc[k];
+		if (!a[RK_ALL] && !pages[k][0] && !pages[k][1]) continue;
+		uint64_t rest = a[RK_CLIST] + a[RK_CPAGE] + a[RK_SKIPPED];
+		Out << "\n    " << std::left << std::setw(8) << kind_name(k) << std::right
+			<< std::setw(14) << a[RK_ALL] << std::setw(14) << (a[RK_ALL] > rest ? a[RK_ALL] - rest : 0)
+			<< std::setw(12) << a[RK_CLIST] << std::setw(12) << a[RK_CPAGE]
+			<< std::setw(12) << a[RK_SKIPPED];
+		if (!damon) Out << std::setw(14) << pages[k][0] << std::setw(12) << pages[k][1];
+	}
+	Out << '\n';
+}
+
+// Private vs shared pages (-sharers) and the private tiers (-privtier).
+static void ShareReport()
+{
+	if (sharersOn) {
+		uint64_t pages[2][2] = {}, sharers[2] = {};		// list x {private, shared}
+		HashLL* lists[2] = { unclist, clist };
+		for (int t = 0; t < 2; ++t)
+			lists[t]->for_each([&](const HashLL::hash_node& n) {
+				if (!n.sharers) return;
+				bool sh = Shared(n.sharers);
+				++pages[t][sh];
+				if (sh) sharers[t] += __builtin_popcount(n.sharers);
+			});
+		const char* names[3] = { "unclist", "clist", "cpage" };
+		Out << "\n  Sharing (-sharers): threads are told apart by tid % 32"
+			<< "\n    " << std::left << std::setw(10) << "tier" << std::right
+			<< std::setw(14) << "private pages" << std::setw(14) << "shared pages"
+			<< std::setw(12) << "sharers" << std::setw(14) << "private acc" << std::setw(14) << "shared acc";
+		for (int t = 0; t < 3; ++t) {
+			Out << "\n    " << std::left << std::setw(10) << names[t] << std::right;
+			if (t < 2)
+				Out << std::setw(14) << pages[t][0] << std::setw(14) << pages[t][1]
+					<< std::setw(12) << std::fixed << std::setprecision(1)
+					<< (pages[t][1] ? (double)sharers[t] / pages[t][1] : 0.0);
+			else
+				Out << std::setw(40) << "";
+			Out << std::setw(14) << share_acc[t][0].load() << std::setw(14) << share_acc[t][1].load();
+		}
+		Out << "\n    (sharers: mean threads per shared page; accesses to pages in neither list are left out)\n";
+	}
+	if (privPages) {
+		uint64_t acc = 0, hits = 0, held = 0, tiers = 0;
+		for (auto& s : stats) {
+			if (!s) continue;
+			acc  += s->privAcc .load(std::memory_order_relaxed);
+			hits += s->privHits.load(std::memory_order_relaxed);
+		}
+		std::unordered_map<uint64_t, uint32_t> copies;
+		for (auto* l : privTiers) {
+			if (!l) continue;
+			++tiers;
+			held += l->get_size();
+			l->for_each([&](const HashLL::hash_node& n) { ++copies[n.vp_num]; });
+		}
+		uint64_t tierAcc = unclist_access + clist_access + cpage_access;
+		Out << "\n  Private tiers (-privtier " << privPages << "): " << tiers << " threads, "
+			<< hits << " hits of " << acc << " accesses (" << std::fixed << std::setprecision(2)
+			<< (acc ? 100.0 * hits / acc : 0.0) << "%); shared unclist " << unclist_access
+			<< " of " << tierAcc << " (" << (tierAcc ? 100.0 * unclist_access / tierAcc : 0.0) << "%)"
+			<< "\n    " << held << " pages held privately, " << copies.size() << " distinct ("
+			<< held - copies.size() << " extra copies of shared pages)\n";
+	}
+}
+
+// -----------------------------------------------------------------------
+// Thread spinup and destruction
+// -----------------------------------------------------------------------
+VOID ThreadStart(THREADID tid, CONTEXT* ctxt, INT32, VOID*)
+{
+    if (tid >= stats.size()) {
+        tlbs.resize(tid+1, nullptr);
+        stats.resize(tid+1);  // now this makes each stats[tid] == nullptr
+        pendingRelease.resize(tid+1);
+        pagevecs.resize(tid+1, nullptr);
+        pcTables.resize(tid+1, nullptr);
+        allocCalls.resize(tid+1, nullptr);
+        privTiers.resize(tid+1, nullptr);
+    }
+
+	++threads_started;
+	if (cores) {
+		coreMap[tid].core     = PickCore(tid);
+		coreMap[tid].resample = KnobResched.Value();
+	}
+
+	// This thread's private caches, refilled from a checkpoint if restoring
+	for (uint32_t id = 0; !cores && id <= CK_L1I; ++id) {
+		CacheLevel* L = CkLevel(id);
+		if (!L || L->shared) continue;
+		CacheUnit* u = new CacheUnit(L->cfg, L->pf);
+		auto it = restoredUnits.find(id << 16 | tid);
+		if (it != restoredUnits.end()) {
+			// The directory isn't checkpointed: with -coherence private
+			// caches restart cold so it never misses a copy.
+			if (!coherence) u->cache.Import(it->second.lines.data());
+			u->cache.SetStats(it->second.acc, it->second.miss);
+		}
+		L->units[tid] = u;
+	}
+	if (!cores && tid >= unitSpan) unitSpan = tid + 1;
+
+	if (tlbOn)
+		tlbs[tid] = new ThreadTlbs{
+			TLBSIM::Tlb(KnobDTlbEntries.Value(), KnobDTlbAssoc.Value()),
+			TLBSIM::Tlb(KnobITlbEntries.Value(), KnobITlbAssoc.Value()),
+			TLBSIM::Tlb(KnobPwcEntries.Value(),  KnobPwcAssoc.Value()) };
+
+    // allocate a new StatPack for this thread
+    stats[tid] = std::make_unique<StatPack>();
+	if (pagevecSize) {
+		pagevecs[tid] = new Pagevec;
+		pagevecs[tid]->owner = tid;
+	}
+	if (privPages) {	// a reused tid starts cold
+		delete privTiers[tid];
+		privTiers[tid] = new HashLL(privPages, page_shift);
+	}
+	if (pcTop) pcTables[tid] = new PcTable;
+	if (allocTop) {		// kept past ThreadFini for exit-time frees
+		if (!allocCalls[tid]) allocCalls[tid] = new AllocCall;
+		else *allocCalls[tid] = AllocCall();
+	}
+	if (regionsOn) {	// the maps file shows other threads' stacks as anon
+		PIN_RWMutexWriteLock(&regionLock);
+		threadStacks.push_back(PIN_GetContextReg(ctxt, REG_STACK_PTR));
+		PIN_RWMutexUnlock(&regionLock);
+	}
+
+	// Restored run: the first thread carries the instruction stats from
+	// before the checkpoint.
+	if (tid == 0) {
+		stats[0]->ins    = restoredStats[0];
+		stats[0]->memIns = restoredStats[1];
+		stats[0]->reads  = restoredStats[2];
+		stats[0]->writes = restoredStats[3];
+	}
+}
+
+
+VOID ThreadFini(THREADID tid, const CONTEXT*, INT32, VOID*)
+{
+	// Private caches go, their stats stay with the level. Another thread
+	// may have loaded the pointer before it was unpublished and not locked
+	// it yet, so the unit is emptied rather than freed and lives until
+	// Fini. Core caches outlive their threads.
+	for (uint32_t id = 0; !cores && id <= CK_L1I; ++id) {
+		CacheLevel* L = CkLevel(id);
+		if (!L || L->shared || !L->units[tid]) continue;
+		CacheUnit* u = L->units[tid];
+		L->units[tid] = nullptr;
+		PIN_GetLock(&u->lock, tid+1);
+		L->retiredAcc  += u->cache.Accesses();
+		L->retiredMiss += u->cache.Misses();
+		uint64_t pf[5];
+		UnitPfStats(*u, pf);
+		for (int k = 0; k < 5; ++k) L->retiredPf[k] += pf[k];
+		u->cache = SimpleCache(L->cfg);		// late invalidations find nothing
+		PIN_ReleaseLock(&u->lock);
+		L->exited.push_back(u);
+	}
+	if (pagevecs[tid]) {
+		PagevecFlush(tid, *pagevecs[tid]);
+		delete pagevecs[tid];
+		pagevecs[tid] = nullptr;
+	}
+	if (pcTables[tid]) {
+		PcTable* t = pcTables[tid];
+		pcTables[tid] = nullptr;
+		PIN_GetLock(&pc_lock, tid+1);
+		RetirePcTable(*t);
+		PIN_ReleaseLock(&pc_lock);
+		delete t;
+	}
+	if (tlbs[tid]) {
+		const TLBSIM::Tlb* t[3] = { &tlbs[tid]->dtlb, &tlbs[tid]->itlb, &tlbs[tid]->pwc };
+		for (int i = 0; i < 3; ++i) {
+			tlbRetired[i][0] += t[i]->hits();
+			tlbRetired[i][1] += t[i]->misses();
+		}
+		delete tlbs[tid];
+		tlbs[tid] = nullptr;
+	}
+}
+
+// -----------------------------------------------------------------------
+// Multi-process support. Forked children inherit the shared mapping (and a
+// copy of our buffered output, hence the flush); they take a reference,
+// start their own report file and counters. Exec'd children come back
+// through main() with -shm_name.
+// -----------------------------------------------------------------------
+static std::string ChildOutfile()
+{
+	return KnobOutfile.Value() + "." + decstr(PIN_GetPid());
+}
+
+VOID BeforeFork(THREADID, const CONTEXT*, VOID*)
+{
+	Out.flush();
+}
+
+VOID AfterForkInChild(THREADID, const CONTEXT*, VOID*)
+{
+	if (shm) shm->refs.fetch_add(1);
+	Out.close();
+	Out.open(ChildOutfile());
+	ResetStats(globalIns);
+}
+
+static bool SetupSharedTiers(uint32_t unclsize, uint32_t clsize, uint64_t clbytes,
+							 char* argv[])
+{
+	shmName = KnobShmName.Value();
+	shmRoot = shmName.empty();
+
+	if (shmRoot) {
+		uint64_t bytes = KnobShmMiB.Value() << 20;
+		if (bytes == 0)
+			bytes = ((uint64_t)unclsize + clsize) * 256 + (64ULL << 20);
+		shmName = "lrupintool." + decstr(PIN_GetPid());
+		shm = SHMARENA::Arena::create(shmName.c_str(), bytes, SHM_HINT);
+		if (!shm) return false;
+
+		auto u = new (shm->allocate(sizeof(HashLL))) HashLL(unclsize, page_shift, shm);
+		auto c = new (shm->allocate(sizeof(HashLL))) HashLL(clsize, page_shift, shm);
+		c->set_byte_cap(clbytes);
+		shm->roots[SHM_UNCLIST] = u;
+		shm->roots[SHM_CLIST]   = c;
+
+		// Children get our command line with -shm_name inserted before "--"
+		for (int i = 0; argv[i]; ++i) {
+			if (std::strcmp(argv[i], "--") == 0) {
+				childPrefix.push_back(const_cast<char*>("-shm_name"));
+				childPrefix.push_back(const_cast<char*>(shmName.c_str()));
+			}
+			childPrefix.push_back(argv[i]);
+		}
+	}
+	else {
+		shm = SHMARENA::Arena::attach(shmName.c_str());
+		if (!shm) return false;
+		for (int i = 0; argv[i]; ++i) childPrefix.push_back(argv[i]);
+	}
+	childPrefix.push_back(nullptr);
+
+	unclist = static_cast<HashLL*>(shm->roots[SHM_UNCLIST]);
+	clist   = static_cast<HashLL*>(shm->roots[SHM_CLIST]);
+	unc_lock.shared = &shm->locks[SHM_UNC_LOCK];
+	c_lock.shared   = &shm->locks[SHM_C_LOCK];
+
+	followChild.Activate();
+	followChild.SetPrefix(childPrefix.data());
+	PIN_AddForkFunction(FPOINT_BEFORE,         BeforeFork,       nullptr);
+	PIN_AddForkFunction(FPOINT_AFTER_IN_CHILD, AfterForkInChild, nullptr);
+	return true;
+}
+
+// -----------------------------------------------------------------------
+// Stop internal threads before Fini runs
+// -----------------------------------------------------------------------
+VOID PrepareForFini(VOID*)
+{
+	toolExiting = true;
+	for (auto& uid : toolThreads) {
+		INT32 code;
+		PIN_WaitForThreadTermination(uid, PIN_INFINITE_TIMEOUT, &code);
+	}
+}
+
+// -----------------------------------------------------------------------
+// Report print
+// -----------------------------------------------------------------------
+VOID Fini(INT32, VOID*)
+{
+	for (auto* pv : pagevecs)	// threads that never reached ThreadFini
+		if (pv) PagevecFlush(0, *pv);
+	FoldThreadHits();
+
+    uint64_t totIns=0, totMem=0, rd=0, wr=0;
+    for(auto& s:stats)
+	{ 
+		if (s)
+		{
+			totIns	+= s->ins	.load(std::memory_order_relaxed);
+			totMem	+= s->memIns.load(std::memory_order_relaxed);
+			rd		+= s->reads	.load(std::memory_order_relaxed);
+			wr		+= s->writes.load(std::memory_order_relaxed);
+		}
+	}
+
+    Out << std::dec << "\n=========== Cache-Sim Report ============\n";
+    Out << "Total instructions       : " << totIns  << '\n';
+    Out << "  memory instructions    : " << totMem  << '\n';
+    Out << "    reads                : " << rd      << '\n';
+    Out << "    writes               : " << wr      << "\n\n";
+
+	static const char* inclName[] = { "nine", "inclusive", "exclusive" };
+	uint64_t llcMiss = 0;
+	auto levelLine = [&](const CacheLevel& L, size_t i) {
+		uint64_t acc, miss;
+		LevelStats(L, acc, miss);
+		Out << std::left << std::setw(25) << (std::string(L.name) + " accesses") << std::right
+			<< ": " << acc << "   misses: " << miss
+			<< "   MPKI: " << std::fixed << std::setprecision(5)
+			<< (totIns? (1000.0*miss)/totIns : 0.0)
+			<< "   (" << (L.shared ? "shared" : "private");
+		if (i > 0) Out << ", " << inclName[L.incl];
+		Out << ")\n";
+		if (i == levels.size() - 1) llcMiss = miss;
+	};
+	for (size_t i = 0; i < levels.size(); ++i) {
+		levelLine(levels[i], i);
+		if (i == 0 && ifetch) levelLine(l1i, 0);
+	}
+	Out << "Back-invalidations       : " << back_invalidations << '\n';
+	for (size_t i = 0; i < levels.size(); ++i) {
+		static const char* pfName[] = { "none", "next", "stride", "stream" };
+		const CacheLevel& L = levels[i];
+		if (L.pf.kind == PREFETCH::NONE) continue;
+		uint64_t pf[5];
+		LevelPfStats(L, pf);
+		Out << std::left << std::setw(25) << (std::string(L.name) + " prefetch (" + pfName[L.pf.kind] + ")")
+			<< std::right << ": issued " << pf[0]
+			<< "   useful " << pf[1] << " (" << std::fixed << std::setprecision(2)
+			<< (pf[0] ? 100.0 * pf[1] / pf[0] : 0.0) << "%)"
+			<< "   late " << pf[2] << "   useless " << pf[3]
+			<< "   dropped " << pf[4] << "   from memory " << pf_memory[i] << '\n';
+	}
+	if (cores)
+		Out << "Cores                    : " << cores << " (-sched " << KnobSched.Value()
+			<< ", " << threads_started << " threads, " << migrations << " migrations)\n";
+
+	Out << "\n  Clist Accesses: " << clist_access     << " ("
+		      << std::fixed << std::setprecision(5)
+			  << ((float)clist_access / (float)llcMiss) * 100.0 << "%)"
+			  << "\n  Unclist Accesses: " << unclist_access << " ("
+			  << std::fixed << std::setprecision(5)
+			  << ((float)unclist_access / (float)llcMiss) * 100.0 << "%)"
+		      << "\n  Cpage   Accesses: " << cpage_access   << " ("
+			  << std::fixed << std::setprecision(5)
+			  << ((float)cpage_access / (float)llcMiss) * 100.0 << "%)"
+			  << "\n  Promotions: " << promotions;
+	if (damon) Out << " (-damon moves regions instead, see below)";
+	Out << "\n  Page policy: " << tiers->name();
+	tiers->report(Out);
+	Out << std::endl;
+
+	ReportCost(CurrentCounts(totIns));
+
+	if (unclpct > 0 || clpct > 0)
+		Out << "\n  RSS sizing: last app RSS " << rss_app
+			<< " bytes, unclist cap " << unclist->get_cap()
+			<< ", clist cap " << clist->get_cap()
+			<< ", resizes " << rss_resizes
+			<< ", shrink evictions " << rss_evictions << '\n';
+
+	Out << "\n  Page size: " << page_size;
+	if (mixedPages) {
+		uint64_t hugeBytes = 0, uncHuge = 0, cHuge = 0;
+		for (auto& r : hugeRanges) hugeBytes += r.second - r.first;
+		unclist->for_each([&](const HashLL::hash_node& n){
+			uncHuge += PageBytes(n.vp_num << page_shift) == HUGE_PAGE_SIZE;
+		});
+		clist->for_each([&](const HashLL::hash_node& n){
+			cHuge += PageBytes(n.vp_num << page_shift) == HUGE_PAGE_SIZE;
+		});
+		Out << " + 2 MiB (-thp)"
+			<< "\n  Huge ranges: " << hugeRanges.size()
+			<< " (" << hugeBytes / HUGE_PAGE_SIZE << " huge pages)"
+			<< "\n  Huge-page L2 misses: " << huge_accesses
+			<< "\n  Huge entries in unclist: " << uncHuge
+			<< "\n  Huge entries in clist: " << cHuge;
+	}
+	Out << '\n';
+
+	if (swapdev) {
+		const SWAPDEV::Stats& sw = swapdev->stats();
+		Out << "\n  Swap (-swap)"
+			<< "\n    writebacks       : " << sw.writes << " pages, " << sw.written << " bytes"
+			<< "\n    major faults     : " << sw.reads << " (" << sw.read_bytes << " bytes read)"
+			<< "\n    avg fault latency: " << std::fixed << std::setprecision(0)
+			<< (sw.reads ? sw.stall / sw.reads : 0.0) << ' ' << KnobLatUnit.Value()
+			<< " (queueing " << (sw.reads ? sw.wait / sw.reads : 0.0) << ')'
+			<< "\n    pages on device  : " << swapdev->size();
+		if (sw.dropped) Out << "\n    dropped (full)   : " << sw.dropped;
+		Out << '\n';
+	}
+
+	if (pagevecSize)
+		Out << "\n  Pagevecs (-pagevec " << pagevecSize << "): " << pagevec_flushes
+			<< " flushes, " << pagevec_batched << " accesses applied in batch\n";
+	if (mapped_bits)
+		Out << "\n  Accessed-bit scans (-scan " << scanEvery << "): " << scans << " scans of "
+			<< scan_pages << " pages, " << scan_young << " found accessed; "
+			<< scan_hits << " accesses to mapped pages\n";
+	if (damon) {
+		const DAMON::Stats& ds = damon->stats();
+		const std::vector<DAMON::Region>& regs = damon->regions();
+		Out << "\n  DAMON regions (-damon " << damonEvery << "): " << ds.samples << " samples, "
+			<< ds.aggregations << " aggregations, " << regs.size() << " regions over "
+			<< damon->pages() << " pages (" << ds.merges << " merges, " << ds.splits << " splits)\n"
+			<< "    placement moved " << damon_promoted << " pages up into unclist, "
+			<< damon_demoted << " pages down\n";
+
+		// the hottest regions of the last aggregation
+		std::vector<DAMON::Region> hot(regs);
+		std::stable_sort(hot.begin(), hot.end(), [](const DAMON::Region& a, const DAMON::Region& b) {
+			return a.last_nr_accesses > b.last_nr_accesses; });
+		const char* tiers[3] = { "unclist", "clist", "cpage" };
+		PIN_RWMutexReadLock(&damonLock);
+		for (size_t i = 0; i < hot.size() && i < 5 && hot[i].last_nr_accesses; ++i) {
+			Out << "    0x" << std::hex << (hot[i].lo << page_shift) << "-0x" << (hot[i].hi << page_shift)
+				<< std::dec << "  " << hot[i].last_nr_accesses << "/" << KnobDamonAggr.Value()
+				<< " samples, age " << hot[i].age << ", " << tiers[PlacedTier(hot[i].lo)] << '\n';
+		}
+		PIN_RWMutexUnlock(&damonLock);
+	}
+	if (lfu)
+		Out << "\n  TinyLFU (-tinylfu): " << lfu_rejects << " clist inserts and "
+			<< lfu_promote_rejects << " promotions rejected, "
+			<< lfu->resets() << " sketch resets\n";
+
+	// -------- refault distances --------
+	if (shadows[TIER_UNCL]) {
+		const char* names[2] = { "unclist", "clist" };
+		Out << "\n  Refault distances (-shadow " << KnobShadow.Value() << ")";
+		for (int t = 0; t < 2; ++t) {
+			const SHADOW::Histogram& h = shadows[t]->histogram();
+			Out << "\n    " << names[t] << ": " << h.total << " refaults, "
+				<< shadows[t]->evictions() << " evictions, "
+				<< shadows[t]->size() << " shadows (" << shadows[t]->dropped() << " dropped)";
+			if (!h.total) continue;
+			Out << "\n      pages larger   refaults  absorbed";
+			uint64_t cum = 0;
+			for (uint32_t k = 1; k < SHADOW::Histogram::BUCKETS; ++k) {
+				if (!h.bucket[k]) continue;
+				cum += h.bucket[k];
+				Out << "\n      < " << std::left << std::setw(13) << (k < 64 ? 1ULL << k : MAXVAL)
+					<< std::right << std::setw(9) << h.bucket[k]
+					<< std::fixed << std::setprecision(1) << std::setw(9)
+					<< 100.0 * cum / h.total << '%';
+			}
+		}
+		Out << '\n';
+	}
+
+	if (pcTop) PcReport();
+	if (allocTop) AllocReport();
+	if (regionsOn) RegionReport();
+	if (sharersOn || privPages) ShareReport();
+
+	Out << "\n  Released by munmap/madvise/brk: " << release_calls << " calls, "
+		<< released_unclist << " unclist pages, "
+		<< released_clist << " clist pages\n";
+
+	// -------- text vs data --------
+	if (ifetch) {
+		uint64_t uncCode = 0, cCode = 0;
+		unclist->for_each([&](const HashLL::hash_node& n){ uncCode += n.code; });
+		clist->for_each([&](const HashLL::hash_node& n){ cCode += n.code; });
+		Out << "\n  Code (-ifetch)"
+			<< "\n    unclist accesses : " << code_unclist_access
+			<< " (data " << unclist_access - code_unclist_access << ")"
+			<< "\n    clist accesses   : " << code_clist_access
+			<< " (data " << clist_access - code_clist_access << ")"
+			<< "\n    cpage accesses   : " << code_cpage_access
+			<< " (data " << cpage_access - code_cpage_access << ")";
+		if (!damon)
+			Out << "\n    code pages in unclist: " << uncCode << " of " << unclist->get_size()
+				<< "\n    code pages in clist  : " << cCode << " of " << clist->get_size();
+		Out << '\n';
+	}
+
+	// -------- coherence --------
+	if (coherence) {
+		std::unordered_map<uint64_t, CohCount> byLine, byPC;
+		size_t entries = 0;
+		for (size_t i = 0; i < DIR_SHARDS; ++i) {
+			DirShard& s = dirShards[i];
+			entries += s.dir.size();
+			for (auto& kv : s.byLine) byLine[kv.first] = kv.second;
+			for (auto& kv : s.byPC) {
+				CohCount& c = byPC[kv.first];
+				c.inval += kv.second.inval;
+				c.miss += kv.second.miss;
+				c.false_miss += kv.second.false_miss;
+			}
+		}
+		Out << "\n  Coherence (-coherence " << KnobCoherence.Value() << ")"
+			<< "\n    invalidating writes: " << coh_upgrades
+			<< " (" << coh_invalidations << " private copies dropped)"
+			<< "\n    downgrades       : " << coh_downgrades
+			<< " (" << coh_writebacks << " dirty write-backs)"
+			<< "\n    coherence misses : " << coh_misses
+			<< " (false sharing: " << coh_false << ")"
+			<< "\n    directory entries: " << entries << '\n';
+
+		auto top = [&](const std::unordered_map<uint64_t, CohCount>& m, const char* title) {
+			std::vector<std::pair<uint64_t, CohCount>> v(m.begin(), m.end());
+			size_t n = std::min<size_t>(KnobTopShare.Value(), v.size());
+			std::partial_sort(v.begin(), v.begin() + n, v.end(), [](auto& a, auto& b){
+				return a.second.miss != b.second.miss ? a.second.miss > b.second.miss
+													  : a.second.inval > b.second.inval;
+			});
+			if (n) Out << "\n  " << title << ":\n";
+			for (size_t i = 0; i < n; ++i)
+				Out << "    0x" << std::hex << v[i].first << std::dec
+					<< "  coherence misses: " << v[i].second.miss
+					<< " (false sharing: " << v[i].second.false_miss << ")"
+					<< "  invalidations: " << v[i].second.inval << '\n';
+		};
+		top(byLine, "Most-contended lines");
+		top(byPC, "Top PCs (misses at the reader, invalidations at the writer)");
+	}
+
+	// -------- translation --------
+	if (tlbOn) {
+		uint64_t t[3][2];
+		std::copy(&tlbRetired[0][0], &tlbRetired[0][0] + 6, &t[0][0]);
+		for (auto* th : tlbs) {
+			if (!th) continue;
+			t[0][0] += th->dtlb.hits(); t[0][1] += th->dtlb.misses();
+			t[1][0] += th->itlb.hits(); t[1][1] += th->itlb.misses();
+			t[2][0] += th->pwc.hits();  t[2][1] += th->pwc.misses();
+		}
+		uint64_t ptUncl = 0, ptCl = 0;
+		unclist->for_each([&](const HashLL::hash_node& n){ ptUncl += (n.vp_num << page_shift) >= PT_REGION; });
+		clist->for_each([&](const HashLL::hash_node& n){ ptCl += (n.vp_num << page_shift) >= PT_REGION; });
+		Out << "\n  TLBs (-tlb)"
+			<< "\n    dTLB misses      : " << t[0][1] << " of " << t[0][0] + t[0][1];
+		if (ifetch)
+			Out << "\n    iTLB misses      : " << t[1][1] << " of " << t[1][0] + t[1][1];
+		Out << "\n    STLB misses      : " << stlb->misses() << " of " << stlb->hits() + stlb->misses()
+			<< "\n    page walks       : " << page_walks
+			<< " (" << std::fixed << std::setprecision(2)
+			<< (page_walks ? (double)walk_refs / page_walks : 0.0) << " PTE reads each)"
+			<< "\n    walks per kilo-ins: " << std::setprecision(3)
+			<< (totIns ? 1000.0 * page_walks / totIns : 0.0)
+			<< "\n    PWC hits         : " << t[2][0] << " of " << t[2][0] + t[2][1] << " probes"
+			<< "\n    page-table pages in unclist: " << ptUncl
+			<< ", clist: " << ptCl << '\n';
+	}
+
+	// -------- write-aware tiers --------
+	std::vector<std::pair<uint32_t, uint64_t>> written;   // (writes, vp_num)
+	uint64_t uncDirty = 0, cDirty = 0;
+	unclist->for_each([&](const HashLL::hash_node& n){
+		uncDirty += n.dirty;
+		if (n.writes) written.push_back({ n.writes, n.vp_num });
+	});
+	clist->for_each([&](const HashLL::hash_node& n){
+		cDirty += n.dirty;
+		if (n.writes) written.push_back({ n.writes, n.vp_num });
+	});
+	if (damon)
+		Out << "\n  Dirty pages and recompressions: not tracked under -damon (no page lists)\n";
+	else
+		Out << "\n  Dirty write-backs: " << dirty_writebacks
+			<< " (into clist: " << clist_writebacks << ")"
+			<< "\n  Recompressions: " << recompressions
+			<< "\n  Dirty pages in unclist: " << uncDirty
+			<< "\n  Dirty pages in clist: " << cDirty << '\n';
+
+	size_t topN = std::min<size_t>(KnobTopWrites.Value(), written.size());
+	std::partial_sort(written.begin(), written.begin() + topN, written.end(),
+					  [](auto& a, auto& b){ return a.first > b.first; });
+	if (topN) Out << "\n  Most-written pages:\n";
+	for (size_t i = 0; i < topN; ++i)
+		Out << "    0x" << std::hex << (written[i].second << page_shift) << std::dec
+			<< "  writes: " << written[i].first << '\n';
+
+	if (cmodel) {
+		uint64_t cpages = clist->get_size();
+		uint64_t cbytes = clist->get_used_bytes();
+		uint64_t ubytes = 0;
+		clist->for_each([&](const HashLL::hash_node& n){
+			ubytes += PageBytes(n.vp_num << page_shift);
+		});
+		Out << "\n  Compressed tier (-cmodel, " << KnobCompressEstimator.Value() << ")"
+			<< "\n    pages held       : " << cpages
+			<< "\n    bytes used       : " << cbytes
+			<< " / " << clist->get_byte_cap()
+			<< "\n    uncompressed     : " << ubytes
+			<< "\n    ratio            : " << std::fixed << std::setprecision(3)
+			<< (cbytes ? (double)ubytes / cbytes : 0.0)
+			<< "\n    bytes saved      : " << (int64_t)(ubytes - cbytes)
+			<< "\n    estimates        : " << est_computed
+			<< " (reused " << est_reused << ")"
+			<< "\n      same-filled    : " << est_kind[PAGECOMP::KIND_SAME]
+			<< "\n      bdi            : " << est_kind[PAGECOMP::KIND_BDI]
+			<< "\n      lz             : " << est_kind[PAGECOMP::KIND_LZ]
+			<< "\n      incompressible : " << est_kind[PAGECOMP::KIND_RAW]
+			<< "\n    byte evictions   : " << clist_byte_evictions
+			<< std::endl;
+	}
+    Out << "==========================================\n";
+
+	for (auto& L : levels) {	// tidy
+		for (auto* u : L.units) delete u;
+		for (auto* u : L.exited) delete u;
+	}
+	for (auto* u : l1i.units) delete u;
+	for (auto* u : l1i.exited) delete u;
+	delete stlb;
+	if (shm) {
+		SHMARENA::Arena::detach(shm, shmName.c_str());	// lists are shared
+	}
+	else {
+		delete unclist;
+		delete clist;
+	}
+	delete tiers;
+	delete swapdev;
+	for (auto* t : shadows) delete t;
+	delete lfu;
+}
+
+// -----------------------------------------------------------------------
+// Cache hierarchy setup
+// -----------------------------------------------------------------------
+static bool ParseInclusion(const std::string& v, Inclusion& out)
+{
+	if      (v == "nine")		out = INCL_NINE;
+	else if (v == "inclusive")	out = INCL_INCLUSIVE;
+	else if (v == "exclusive")	out = INCL_EXCLUSIVE;
+	else return false;
+	return true;
+}
+
+static bool ParsePrefetch(const std::string& v, PREFETCH::Config& out)
+{
+	if      (v == "none")	out.kind = PREFETCH::NONE;
+	else if (v == "next")	out.kind = PREFETCH::NEXT_LINE;
+	else if (v == "stride")	out.kind = PREFETCH::STRIDE;
+	else if (v == "stream")	out.kind = PREFETCH::STREAM;
+	else return false;
+	out.degree   = KnobPfDegree.Value();
+	out.distance = KnobPfDistance.Value();
+	out.delay    = KnobPfDelay.Value();
+	out.blk      = KnobBlkBytes.Value();
+	out.page     = BASE_PAGE_SIZE;
+	return true;
+}
+
+// Per-thread levels fill their slots as threads start; per-core ones now.
+static void PrivateUnits(CacheLevel& L)
+{
+	L.units.assign(PIN_MAX_THREADS, nullptr);
+	for (uint32_t c = 0; c < cores; ++c) L.units[c] = new CacheUnit(L.cfg, L.pf);
+}
+
+static void AddLevel(const char* name, const SimpleCacheConfig& cfg, bool shared, Inclusion incl,
+					 const PREFETCH::Config& pf = PREFETCH::Config())
+{
+	CacheLevel L;
+	L.name   = name;
+	L.cfg    = cfg;
+	L.shared = shared;
+	L.incl   = incl;
+	L.pf     = pf;
+	if (shared) L.units.push_back(new CacheUnit(cfg, pf));
+	else        PrivateUnits(L);
+	levels.push_back(std::move(L));
+}
+
+// -----------------------------------------------------------------------
+// Main method, execution + params here
+// -----------------------------------------------------------------------
+int main(int argc, char* argv[])
 {
     if(PIN_Init(argc, argv)){
         Out << "Pin init failed\n";
@@ -571,33 +3970,260 @@ int main(int argc, char* argv[])
 	uint32_t clsize   	  = KnobCompressedListSize.Value();
 	unclist_freq		  = KnobPromoteUncompressedFrequency.Value();
 	clist_freq	  		  = KnobPromoteCompressedFrequency.Value();
-	Out.open(KnobOutfile.Value());
 	
-	// Initializing page doubly linked lists
-	clist   = new HASHLL::HashLL(clsize);
-	unclist = new HASHLL::HashLL(unclsize);
+	// Page granularity
+	page_size = KnobPageSize.Value();
+	if (page_size < 64 || (page_size & (page_size - 1))) {
+		std::cerr << "-pagesize must be a power of two\n";
+		return 1;
+	}
+	page_shift = 63 - __builtin_clzll(page_size);
+	mixedPages = KnobHugePages.Value();
+	if (mixedPages && page_size >= HUGE_PAGE_SIZE) {
+		std::cerr << "-thp needs -pagesize below 2 MiB\n";
+		return 1;
+	}
+
+	// Content-aware mode: clsize pages of RAM back the compressed pool, and
+	// the page cap only bounds entries (the smallest entry is its overhead).
+	cmodel = KnobCompressModel.Value();
+	uint64_t clbytes = 0;
+	if (cmodel) {
+		const std::string& est = KnobCompressEstimator.Value();
+		if      (est == "bdi")	cest_mode = PAGECOMP::MODE_BDI;
+		else if (est == "lz")	cest_mode = PAGECOMP::MODE_LZ;
+		else if (est != "best")
+			std::cerr << "Unknown -cest '" << est << "', using best\n";
+
+		clbytes = KnobCompressedListBytes.Value();
+		if (clbytes == 0) clbytes = (uint64_t)clsize * page_size;
+		uint64_t entries = clbytes / PAGECOMP::ENTRY_OVERHEAD;
+		clsize = (uint32_t)std::min<uint64_t>(entries, std::numeric_limits<uint32_t>::max());
+	}
+
+	// Initializing page doubly linked lists: private, or shared with all
+	// descendant processes. Exec'd children (-shm_name) report separately.
+	bool attaching = !KnobShmName.Value().empty();
+	Out.open(attaching ? ChildOutfile() : KnobOutfile.Value());
+	if (KnobFollowExecv.Value() &&
+		!SetupSharedTiers(unclsize, clsize, clbytes, argv)) {
+		std::cerr << "Shared page tiers unavailable, using private lists\n";
+	}
+	if (!shm) {
+		clist   = new HASHLL::HashLL(clsize, page_shift);
+		unclist = new HASHLL::HashLL(unclsize, page_shift);
+		clist->set_byte_cap(clbytes);
+	}
 	expansionFrequency = KnobExpansionFrequency.Value();
 
+	// Page-tier scheme: other than promote, a TIERPOLICY policy owns the
+	// uncompressed tier and clist stays the compressed LRU pool beneath
+	// it. Its state is private to this process, so shared tiers keep
+	// promote.
+	const std::string& pol = KnobPolicy.Value();
+	TIERPOLICY::PageTierPolicy* policy = nullptr;
+	if (pol != "promote") {
+		if (shm)
+			std::cerr << "-policy " << pol << " cannot share tiers across processes, using promote\n";
+		else if (!(policy = TIERPOLICY::make_policy(pol.c_str(), unclist->get_cap())))
+			std::cerr << "Unknown -policy '" << pol << "', using promote\n";
+	}
+	if (policy) tiers = new ResidentScheme(policy);
+	else        tiers = new PromoteScheme;
+
+	// Swap tier below clist. The eviction callback is process-local, so
+	// shared tiers go without.
+	if (KnobSwap.Value()) {
+		if (shm)
+			std::cerr << "-swap cannot be used with shared tiers, ignored\n";
+		else {
+			SWAPDEV::Config sc;
+			sc.read_lat = KnobLatSwap.Value();
+			sc.bw       = KnobSwapBw.Value();
+			sc.slots    = KnobSwapPages.Value();
+			swapdev = new SWAPDEV::Device(sc);
+		}
+	}
+	if (KnobShadow.Value()) {
+		if (shm)
+			std::cerr << "-shadow cannot be used with shared tiers, ignored\n";
+		else {
+			for (auto*& t : shadows) t = new SHADOW::Table(KnobShadow.Value());
+			unclist->on_evict(UnclistEvicted, nullptr);
+		}
+	}
+	if (swapdev || shadows[TIER_CL] || (cmodel && !shm)) clist->on_evict(ClistEvicted, nullptr);
+	if (cmodel && !shm) unclist->on_evict(UnclistEvicted, nullptr);
+	if (cmodel && shm)		// twice what the tiers can hold
+		est_bound = std::max<uint64_t>(2 * (unclist->get_cap() + clist->get_cap()), 1 << 16);
+	pagevecSize = std::min<uint32_t>(KnobPagevec.Value(), MAX_PAGEVEC);
+	pagevecIns  = KnobPagevecIns.Value();
+	scanEvery   = KnobScan.Value();
+	if (scanEvery && (shm || policy)) {
+		std::cerr << "-scan applies to private tiers under -policy promote only, ignored\n";
+		scanEvery = 0;
+	}
+	if (scanEvery) {
+		mapped_bits   = new REFBITS::Bitmap;
+		accessed_bits = new REFBITS::Bitmap;
+		dirty_bits    = new REFBITS::Bitmap;
+		PIN_SemaphoreInit(&scanSem);
+		scanAt = scanEvery;
+		unclist->on_evict(UnclistEvicted, nullptr);
+	}
+	pcTop    = KnobPcStats.Value();
+	allocTop = KnobAllocSites.Value();
+	if (pcTop || allocTop) PIN_InitSymbols();
+	if (pcTop) PIN_InitLock(&pc_lock);
+	if (allocTop) {
+		PIN_InitLock(&alloc_lock);
+		IMG_AddInstrumentFunction(ImageLoad, nullptr);
+	}
+	damonEvery = KnobDamon.Value();
+	if (damonEvery && shm) {
+		std::cerr << "-damon cannot be used with shared tiers, ignored\n";
+		damonEvery = 0;
+	}
+	if (damonEvery) {
+		if (policy || scanEvery || pagevecSize || KnobSharers.Value())
+			std::cerr << "-damon places whole regions; -policy, -scan, -pagevec and -sharers have no effect\n";
+		DAMON::Config dc;
+		dc.aggr_samples = KnobDamonAggr.Value();
+		dc.min_regions  = KnobDamonMin.Value();
+		dc.max_regions  = KnobDamonMax.Value();
+		damon      = new DAMON::Monitor(dc);
+		damon_bits = new REFBITS::Bitmap;
+		PIN_RWMutexInit(&damonLock);
+		PIN_SemaphoreInit(&damonSem);
+		damonAt = damonEvery;
+		DamonRanges();
+		DamonPlace();
+	}
+	sharersOn = KnobSharers.Value() && !damon;	// sharers live on list nodes
+	privPages = KnobPrivTier.Value();
+	regionsOn = KnobRegions.Value();
+	{
+		const std::string fp = KnobFilePages.Value();
+		if (fp == "skip") skipFilePages = regionsOn = true;
+		else if (fp != "tier")
+			std::cerr << "Unknown -filepages '" << fp << "', using tier\n";
+	}
+	if (regionsOn) {
+		PIN_RWMutexInit(&regionLock);
+		IMG_AddInstrumentFunction(RegionImageLoad, nullptr);
+		IMG_AddUnloadFunction(RegionImageUnload, nullptr);
+	}
+	if (KnobTinyLfu.Value()) {	// under a -policy, for clist inserts only
+		uint64_t pages = (uint64_t)unclist->get_cap() + clist->get_cap();
+		lfu = new TINYLFU::Sketch(std::min<uint64_t>(pages, 1ULL << 24));
+	}
+	cost = { { KnobLatL1.Value(), KnobLatL2.Value(), KnobLatL3.Value() }, KnobLatUncl.Value(),
+			 KnobLatCl.Value(), KnobLatCpage.Value(), KnobLatPromote.Value(),
+			 KnobLatRecompress.Value(), KnobBaseCPI.Value() };
+
 	/* 
-		Clist and unclist sizes are parameters... we need to measure RSS for those.
-		Is there a means of determining the RSS of the program that is being run
-		THROUGH Pin?	
+		Clist and unclist sizes are parameters, or fractions of the target's
+		RSS with -unclpct/-clpct: an internal thread samples /proc/<pid>/statm
+		(Pin runs in the target's process) and resizes both lists.
 	*/
 
-    cfgL1 = { KnobL1Size.Value(), KnobBlkBytes.Value(), KnobL1Assoc.Value() };
-    cfgL2 = { KnobL2Size.Value(), KnobBlkBytes.Value(), KnobL2Assoc.Value() };
-    L2    = new SimpleCache(cfgL2);                     // ← constructed *after* knobs parsed
+	// Cores and their scheduler come first: they decide who owns the
+	// private caches.
+	cores = std::min<uint32_t>(KnobCores.Value(), PIN_MAX_THREADS);
+	if (cores) {
+		const std::string& sc = KnobSched.Value();
+		if      (sc == "rr")		sched = CORE_RR;
+		else if (sc == "affinity")	sched = CORE_AFFINITY;
+		else if (sc != "static")
+			std::cerr << "Unknown -sched '" << sc << "', using static\n";
+		coreMap.resize(PIN_MAX_THREADS);
+		unitSpan = cores;
+	}
+
+	// Cache hierarchy: L1D private, L2 and the optional L3 as configured
+	Inclusion l2incl, l3incl;
+	if (!ParseInclusion(KnobL2Incl.Value(), l2incl) ||
+		!ParseInclusion(KnobL3Incl.Value(), l3incl)) {
+		std::cerr << "-l2incl/-l3incl take nine, inclusive or exclusive\n";
+		return 1;
+	}
+	PREFETCH::Config pfL1, pfL2;
+	if (!ParsePrefetch(KnobPfL1.Value(), pfL1) || !ParsePrefetch(KnobPfL2.Value(), pfL2)) {
+		std::cerr << "-pf_l1/-pf_l2 take none, next, stride or stream\n";
+		return 1;
+	}
+	AddLevel("L1", { KnobL1Size.Value(), KnobBlkBytes.Value(), KnobL1Assoc.Value() },
+			 false, INCL_NINE, pfL1);
+	AddLevel("L2", { KnobL2Size.Value(), KnobBlkBytes.Value(), KnobL2Assoc.Value() },
+			 KnobL2Shared.Value(), l2incl, pfL2);
+	if (KnobL3Size.Value())
+		AddLevel("L3", { KnobL3Size.Value(), KnobBlkBytes.Value(), KnobL3Assoc.Value() },
+				 KnobL3Shared.Value(), l3incl);
+	ifetch = KnobIFetch.Value();
+	if (ifetch) {
+		l1i.name = "L1I";
+		l1i.cfg  = { KnobL1ISize.Value(), KnobBlkBytes.Value(), KnobL1IAssoc.Value() };
+		PrivateUnits(l1i);
+	}
+	const std::string& coh = KnobCoherence.Value();
+	if (coh == "mesi" || coh == "moesi") {
+		coherence = true;
+		dirShards = new DirShard[DIR_SHARDS];
+		for (size_t i = 0; i < DIR_SHARDS; ++i)
+			dirShards[i].dir = COH::Directory(coh == "moesi" ? COH::MOESI : COH::MESI);
+	}
+	else if (coh != "none")
+		std::cerr << "Unknown -coherence '" << coh << "', using none\n";
+	tlbOn  = KnobTlb.Value();
+	if (tlbOn) stlb = new TLBSIM::Tlb(KnobSTlbEntries.Value(), KnobSTlbAssoc.Value());
 
-    PIN_InitLock(&l2Lock);
 	PIN_InitLock(&reset_lock);
-	PIN_InitLock(&unc_lock);
-	PIN_InitLock(&c_lock);
+	unc_lock.Init();
+	c_lock.Init();
 	PIN_InitLock(&cpage_lock);
+	PIN_InitLock(&swap_lock);
+	PIN_InitLock(&shadow_lock);
+	PIN_InitLock(&lfu_lock);
+	PIN_InitLock(&est_lock);
+	PIN_InitLock(&stlbLock);
+	PIN_RWMutexInit(&hugeLock);
 
     INS_AddInstrumentFunction(Instruction,  nullptr);
+	if (ifetch) TRACE_AddInstrumentFunction(Trace, nullptr);
     PIN_AddThreadStartFunction(ThreadStart, nullptr);
     PIN_AddThreadFiniFunction (ThreadFini,  nullptr);
     PIN_AddFiniFunction       (Fini,        nullptr);
+    PIN_AddPrepareForFiniFunction(PrepareForFini, nullptr);
+    PIN_AddSyscallEntryFunction(SyscallEntry, nullptr);
+    PIN_AddSyscallExitFunction (SyscallExit,  nullptr);
+
+	if (mixedPages) {
+		RefreshHugeRanges();
+		SpawnToolThread(SmapsThread);
+	}
+
+	// RSS-relative sizing: lists start at -unclsize/-clsize until the
+	// first sample; the baseline is taken before the application runs.
+	unclpct = KnobUncompressedPct.Value();
+	clpct   = KnobCompressedPct.Value();
+	if (shm && !shmRoot) unclpct = clpct = 0;	// root owns the shared sizes
+	if (unclpct > 0 || clpct > 0) {
+		SampleRss(rss_base);
+		SpawnToolThread(RssThread);
+	}
+	if (regionsOn) {
+		RefreshRegions();
+		SpawnToolThread(RegionsThread);
+	}
+	if (scanEvery) SpawnToolThread(ScanThread);
+	if (damonEvery) SpawnToolThread(DamonThread);
+
+	// Checkpoints cover this process's private state; processes attached
+	// to shared tiers leave restore to the root.
+	checkpointAt = KnobCheckpointAt.Value();
+	if (!KnobRestoreFrom.Value().empty() && !attaching &&
+		!RestoreCheckpoint(KnobRestoreFrom.Value()))
+		return 1;
 
     PIN_StartProgram();    // never returns
     return 0;
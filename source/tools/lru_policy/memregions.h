@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "procfs.h"
+
+#if !defined(MEMREGIONS_H)
+#define MEMREGIONS_H
+
+namespace MEMREGIONS
+{
+
+// ---------------------------------------------------------------------------
+// What a virtual address belongs to. KIND_OTHER covers the kernel's special
+// mappings ([vdso], [vvar], ...) and anything not mapped.
+// ---------------------------------------------------------------------------
+enum Kind { KIND_HEAP, KIND_STACK, KIND_ANON, KIND_FILE, KIND_CODE, KIND_OTHER, KINDS };
+
+inline const char *kind_name(int k)
+{
+    static const char *names[KINDS] = { "heap", "stack", "anon", "file", "code", "other" };
+    return k >= 0 && k < KINDS ? names[k] : "?";
+}
+
+// Executable and file-backed memory goes back to its file under pressure
+// (the page cache) instead of being compressed.
+inline bool file_backed(int k) { return k == KIND_FILE || k == KIND_CODE; }
+
+inline Kind classify(const PROCFS::Mapping &m)
+{
+    if (m.path == "[heap]") return KIND_HEAP;
+    if (m.path.compare(0, 6, "[stack") == 0) return KIND_STACK;
+    if (m.perms[2] == 'x') return KIND_CODE;
+    if (!m.path.empty() && m.path[0] == '[') return KIND_OTHER;
+    if (m.inode || !m.path.empty()) return KIND_FILE;
+    return KIND_ANON;
+}
+
+// ---------------------------------------------------------------------------
+// Disjoint [lo, hi) address ranges and their kinds, sorted. set() replaces
+// whatever overlapped, as a MAP_FIXED mmap does; clear() punches a hole, as
+// munmap does. Lookups are a binary search.
+// ---------------------------------------------------------------------------
+class Map
+{
+public:
+    struct Range { uint64_t lo, hi; Kind kind; };
+
+    void set(uint64_t lo, uint64_t hi, Kind kind)
+    {
+        if (hi <= lo) return;
+        clear(lo, hi);
+        auto it = std::lower_bound(ranges.begin(), ranges.end(), lo,
+                                   [](const Range &r, uint64_t a) { return r.lo < a; });
+        ranges.insert(it, Range{ lo, hi, kind });
+    }
+
+    void clear(uint64_t lo, uint64_t hi)
+    {
+        if (hi <= lo) return;
+        std::vector<Range> out;
+        out.reserve(ranges.size() + 1);
+        for (auto &r : ranges)
+        {
+            if (r.hi <= lo || r.lo >= hi) { out.push_back(r); continue; }
+            if (r.lo < lo) out.push_back(Range{ r.lo, lo, r.kind });
+            if (r.hi > hi) out.push_back(Range{ hi, r.hi, r.kind });
+        }
+        ranges.swap(out);
+    }
+
+    Kind kind_of(uint64_t addr) const
+    {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), addr,
+                                   [](uint64_t a, const Range &r) { return a < r.lo; });
+        return it != ranges.begin() && addr < std::prev(it)->hi ? std::prev(it)->kind : KIND_OTHER;
+    }
+
+    // Rebuild from a maps listing. Mappings holding one of `stacks` (thread
+    // stack pointers) are stacks; glibc gives threads plain anonymous ones.
+    void assign(const std::vector<PROCFS::Mapping> &maps, const std::vector<uint64_t> &stacks)
+    {
+        ranges.clear();
+        for (auto &m : maps)
+        {
+            Kind k = classify(m);
+            for (uint64_t sp : stacks)
+                if (k == KIND_ANON && sp >= m.start && sp < m.end) k = KIND_STACK;
+            if (!ranges.empty() && ranges.back().hi == m.start && ranges.back().kind == k)
+                ranges.back().hi = m.end;
+            else
+                ranges.push_back(Range{ m.start, m.end, k });
+        }
+    }
+
+    const std::vector<Range>& all() const { return ranges; }
+    size_t size() const { return ranges.size(); }
+
+private:
+    std::vector<Range> ranges;
+};
+
+} // namespace MEMREGIONS
+
+#endif /* MEMREGIONS_H */
@@ -0,0 +1,63 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "memregions.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Mapping classification            o
+// Thread stacks from stack pointers o
+// set() overrides, clear() punches  o
+// Lookups at range edges            o
+// -----------------------------------------------------------------------
+
+using namespace MEMREGIONS;
+
+static PROCFS::Mapping map(const char *line)
+{
+    PROCFS::Mapping m;
+    bool ok = PROCFS::parse_map_line(line, m);
+    assert(ok);
+    return m;
+}
+
+int main()
+{
+    std::vector<PROCFS::Mapping> maps = {
+        map("00400000-00452000 r-xp 00000000 08:02 173521      /usr/bin/app"),
+        map("00651000-00652000 rw-p 00051000 08:02 173521      /usr/bin/app"),
+        map("00652000-00700000 rw-p 00000000 00:00 0           [heap]"),
+        map("7f0000000000-7f0000100000 rw-p 00000000 00:00 0"),
+        map("7f0000100000-7f0000200000 rw-p 00000000 00:00 0"),
+        map("7f0000200000-7f0000300000 r--s 00000000 00:05 99  /dev/shm/x"),
+        map("7ffc00000000-7ffc00021000 rw-p 00000000 00:00 0   [stack]"),
+        map("7ffc00100000-7ffc00102000 r-xp 00000000 00:00 0   [vdso]"),
+    };
+    assert(classify(maps[0]) == KIND_CODE && classify(maps[1]) == KIND_FILE);
+    assert(classify(maps[2]) == KIND_HEAP && classify(maps[3]) == KIND_ANON);
+    assert(classify(maps[5]) == KIND_FILE && classify(maps[6]) == KIND_STACK);
+    assert(classify(maps[7]) == KIND_CODE);      // executable before special
+    assert(file_backed(KIND_CODE) && file_backed(KIND_FILE) && !file_backed(KIND_ANON));
+
+    // the second anonymous mapping holds a thread's stack pointer
+    Map m;
+    m.assign(maps, { 0x7f0000180000ULL });
+    assert(m.kind_of(0x400000) == KIND_CODE && m.kind_of(0x451fff) == KIND_CODE);
+    assert(m.kind_of(0x452000) == KIND_OTHER);   // gap
+    assert(m.kind_of(0x651000) == KIND_FILE && m.kind_of(0x6fffff) == KIND_HEAP);
+    assert(m.kind_of(0x7f00000fffffULL) == KIND_ANON && m.kind_of(0x7f0000100000ULL) == KIND_STACK);
+    assert(m.kind_of(0x7ffc00000010ULL) == KIND_STACK && m.kind_of(0) == KIND_OTHER);
+
+    // mmap over the middle of the heap, then munmap across two ranges
+    size_t n = m.size();
+    m.set(0x660000, 0x670000, KIND_ANON);
+    assert(m.size() == n + 2);
+    assert(m.kind_of(0x65ffff) == KIND_HEAP && m.kind_of(0x660000) == KIND_ANON && m.kind_of(0x670000) == KIND_HEAP);
+    m.clear(0x668000, 0x680000);
+    assert(m.kind_of(0x667fff) == KIND_ANON && m.kind_of(0x668000) == KIND_OTHER && m.kind_of(0x680000) == KIND_HEAP);
+    m.set(0x10, 0x10, KIND_ANON);                // empty: no-op
+    assert(m.kind_of(0x10) == KIND_OTHER);
+
+    std::cout << "memregions ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>      // memcpy
+#include <algorithm>
+
+#if !defined(PAGECOMP_H)
+#define PAGECOMP_H
+
+namespace PAGECOMP
+{
+
+// ---------------------------------------------------------------------------
+// Fast compressed-size estimators for a page worth of bytes.
+// None of these actually produce output: they only walk the data once and
+// count what a real compressor would emit, so they are cheap enough to run
+// on every page that enters the compressed tier.
+// ---------------------------------------------------------------------------
+
+// Per-entry bookkeeping charged on top of the payload (roughly a zswap_entry
+// plus allocator slack). Also the smallest footprint a compressed page has.
+constexpr uint32_t ENTRY_OVERHEAD = 64;
+
+enum Kind : uint8_t { KIND_SAME = 0, KIND_BDI = 1, KIND_LZ = 2, KIND_RAW = 3 };
+
+enum Mode : uint8_t { MODE_BEST = 0, MODE_BDI = 1, MODE_LZ = 2 };
+
+struct Estimate
+{
+    uint32_t bytes;     // estimated compressed payload size
+    Kind     kind;      // which estimator produced it
+};
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+static inline uint64_t load64(const uint8_t *p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+static inline uint32_t load32(const uint8_t *p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+static inline uint16_t load16(const uint8_t *p) { uint16_t v; std::memcpy(&v, p, 2); return v; }
+
+static inline bool fits_signed(int64_t d, uint32_t bytes)
+{
+    int64_t lim = int64_t(1) << (bytes * 8 - 1);
+    return d >= -lim && d < lim;
+}
+
+// ---------------------------------------------------------------------------
+// Same-filled detection (zswap stores these as a single word, no payload).
+// ---------------------------------------------------------------------------
+inline bool same_filled(const uint8_t *p, uint32_t n)
+{
+    if (n < 8) return true;
+    uint64_t first = load64(p);
+    for (uint32_t i = 8; i + 8 <= n; i += 8)
+        if (load64(p + i) != first) return false;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Base-Delta-Immediate, applied per 64-byte line. Each line picks the
+// smallest of: all-zero, repeated 8-byte value, or base+delta with
+// (base, delta) in {8,4,2} x {1,2,4} bytes, using either the line's first
+// word or an implicit zero base for each element. Falls back to raw.
+// ---------------------------------------------------------------------------
+inline uint32_t bdi_line(const uint8_t *p)
+{
+    constexpr uint32_t LINE = 64;
+
+    bool zero = true, rep = true;
+    uint64_t w0 = load64(p);
+    for (uint32_t i = 0; i < LINE; i += 8)
+    {
+        uint64_t w = load64(p + i);
+        zero &= (w == 0);
+        rep  &= (w == w0);
+    }
+    if (zero) return 1;
+    if (rep)  return 8;
+
+    static const uint8_t combos[][2] = {        // {base bytes, delta bytes}
+        {8,1}, {4,1}, {8,2}, {2,1}, {4,2}, {8,4}
+    };
+
+    uint32_t best = LINE;
+    for (auto &c : combos)
+    {
+        uint32_t bb = c[0], db = c[1];
+        uint32_t cost = bb + (LINE / bb) * db;
+        if (cost >= best) continue;
+
+        int64_t base = bb == 8 ? int64_t(load64(p))
+                     : bb == 4 ? int64_t(int32_t(load32(p)))
+                     :           int64_t(int16_t(load16(p)));
+        bool ok = true;
+        for (uint32_t i = 0; ok && i < LINE; i += bb)
+        {
+            int64_t v = bb == 8 ? int64_t(load64(p + i))
+                      : bb == 4 ? int64_t(int32_t(load32(p + i)))
+                      :           int64_t(int16_t(load16(p + i)));
+            ok = fits_signed(v - base, db) || fits_signed(v, db);
+        }
+        if (ok) best = cost;
+    }
+    return best;
+}
+
+inline uint32_t bdi_size(const uint8_t *p, uint32_t n)
+{
+    uint32_t total = 0, lines = n / 64;
+    for (uint32_t l = 0; l < lines; ++l)
+        total += bdi_line(p + l * 64);
+    total += n - lines * 64;                // ragged tail stays raw
+    total += (lines + 1) / 2;               // 4-bit encoding tag per line
+    return std::min(total, n);
+}
+
+// ---------------------------------------------------------------------------
+// LZ4-style greedy byte-level estimator: a 4-byte hash finds the previous
+// occurrence, matches are extended forward, and the output is costed with
+// LZ4's token/literal/offset encoding.
+// ---------------------------------------------------------------------------
+inline uint32_t lz_size(const uint8_t *p, uint32_t n)
+{
+    constexpr uint32_t HASH_BITS = 12;
+    constexpr uint32_t MIN_MATCH = 4;
+    uint32_t table[1u << HASH_BITS];
+    std::memset(table, 0, sizeof(table));   // 0 = empty, else pos+1
+
+    auto len_extra = [](uint32_t len) -> uint32_t
+    { return len >= 15 ? 1 + (len - 15) / 255 : 0; };
+
+    uint32_t out = 0, lit = 0, i = 0;
+    while (i + MIN_MATCH <= n)
+    {
+        uint32_t v = load32(p + i);
+        uint32_t h = (v * 2654435761u) >> (32 - HASH_BITS);
+        uint32_t cand = table[h];
+        table[h] = i + 1;
+
+        if (cand && i - (cand - 1) <= 65535 && load32(p + cand - 1) == v)
+        {
+            uint32_t m = cand - 1, len = MIN_MATCH;
+            while (i + len < n && p[m + len] == p[i + len]) ++len;
+            out += 1 + lit + len_extra(lit) + 2 + len_extra(len - MIN_MATCH);
+            lit  = 0;
+            i   += len;
+        }
+        else
+        {
+            ++lit;
+            ++i;
+        }
+    }
+    lit += n - i;
+    out += 1 + lit + len_extra(lit);
+    return std::min(out, n);
+}
+
+// ---------------------------------------------------------------------------
+// Estimate the compressed size of one page using the selected estimator.
+// ---------------------------------------------------------------------------
+inline Estimate estimate(const uint8_t *p, uint32_t n, Mode mode)
+{
+    if (same_filled(p, n))
+        return { 0, KIND_SAME };
+
+    uint32_t bdi = mode != MODE_LZ  ? bdi_size(p, n) : n;
+    uint32_t lz  = mode != MODE_BDI ? lz_size(p, n)  : n;
+
+    if (bdi >= n && lz >= n) return { n,   KIND_RAW };
+    if (bdi <= lz)           return { bdi, KIND_BDI };
+    return { lz, KIND_LZ };
+}
+
+} // namespace PAGECOMP
+
+#endif /* PAGECOMP_H */
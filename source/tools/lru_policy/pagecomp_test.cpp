@@ -0,0 +1,44 @@
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "pagecomp.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Zero / same-filled pages o
+// Small-delta pages (BDI)  o
+// Repetitive text (LZ)     o
+// Random data (raw)        o
+// -----------------------------------------------------------------------
+
+int main()
+{
+    uint8_t page[4096];
+
+    std::memset(page, 0, sizeof(page));
+    assert(PAGECOMP::estimate(page, 4096, PAGECOMP::MODE_BEST).kind == PAGECOMP::KIND_SAME);
+
+    for (uint32_t i = 0; i < 4096 / 8; i++)
+    {
+        uint64_t v = 0x7f0000001000ULL + i * 8;   // pointer-like array
+        std::memcpy(page + i * 8, &v, 8);
+    }
+    PAGECOMP::Estimate bdi = PAGECOMP::estimate(page, 4096, PAGECOMP::MODE_BDI);
+    assert(bdi.kind == PAGECOMP::KIND_BDI && bdi.bytes < 1200);
+
+    const char *word = "the quick brown fox ";
+    for (uint32_t i = 0; i < 4096; i++) page[i] = word[i % 20];
+    PAGECOMP::Estimate lz = PAGECOMP::estimate(page, 4096, PAGECOMP::MODE_LZ);
+    assert(lz.kind == PAGECOMP::KIND_LZ && lz.bytes < 256);
+
+    uint32_t x = 2463534242u;
+    for (uint32_t i = 0; i < 4096; i++)
+    {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        page[i] = (uint8_t)x;
+    }
+    assert(PAGECOMP::estimate(page, 4096, PAGECOMP::MODE_BEST).kind == PAGECOMP::KIND_RAW);
+
+    std::cout << "bdi " << bdi.bytes << " lz " << lz.bytes << std::endl;
+    return 0;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if !defined(PREFETCH_H)
+#define PREFETCH_H
+
+namespace PREFETCH
+{
+
+// ---------------------------------------------------------------------------
+// Hardware prefetcher models for one cache:
+//   NEXT_LINE  the next `degree` lines after a trigger
+//   STRIDE     per-PC stride table (reference prediction table)
+//   STREAM     up to STREAMS ascending/descending streams, trained on
+//              triggers and confirmed after two steps in one direction
+// A trigger is a demand miss, or the first hit on a prefetched line. The
+// first candidate is `distance` steps ahead. Like real prefetchers none
+// crosses the page of the access that caused it.
+//
+// Outputs go to caller arrays (MAX_DEGREE candidates, QUEUE ready lines),
+// so the simulator can collect them under a cache lock without allocating.
+//
+// Candidates wait in a small queue for `delay` demand accesses to the
+// cache before they land; a demand miss on a queued line finds it late.
+// ---------------------------------------------------------------------------
+enum Kind : uint8_t { NONE, NEXT_LINE, STRIDE, STREAM };
+
+struct Config
+{
+    Kind     kind     = NONE;
+    uint32_t degree   = 2;
+    uint32_t distance = 1;
+    uint32_t delay    = 4;
+    uint32_t blk      = 64;
+    uint64_t page     = 4096;
+};
+
+class Prefetcher
+{
+public:
+    static constexpr uint32_t TABLE   = 256;   // stride entries
+    static constexpr uint32_t STREAMS = 16;
+    static constexpr uint32_t WINDOW  = 16;    // lines a stream may skip
+    static constexpr size_t   QUEUE   = 32;    // in-flight prefetches
+    static constexpr uint32_t MAX_DEGREE = 16;
+
+    explicit Prefetcher(const Config &c = Config())
+        : cfg(c), table(c.kind == STRIDE ? TABLE : 0),
+          streams(c.kind == STREAM ? STREAMS : 0)
+    {
+        if (cfg.degree > MAX_DEGREE) cfg.degree = MAX_DEGREE;
+        queue.reserve(QUEUE);
+    }
+
+    bool active() const { return cfg.kind != NONE; }
+
+    // Demand access to `line` at this cache; returns the number of new
+    // candidates written to `out`.
+    size_t train(uint64_t pc, uint64_t line, bool trigger, uint64_t *out)
+    {
+        size_t n = 0;
+        switch (cfg.kind)
+        {
+        case NEXT_LINE:
+            if (trigger) n = emit(line, 1, out);
+            break;
+        case STRIDE: {
+            Stride &e = table[(pc >> 2) % TABLE];
+            if (e.pc != pc) { e = { pc, line, 0, 0 }; break; }
+            int64_t s = (int64_t)(line - e.last) / (int64_t)cfg.blk;
+            if (s == 0) break;                           // same line again
+            if (s == e.stride) { if (e.conf < 3) ++e.conf; }
+            else { e.stride = s; e.conf = 0; }
+            e.last = line;
+            if (e.conf >= 2) n = emit(line, e.stride, out);
+            break;
+        }
+        case STREAM:
+            if (trigger) n = stream(line, out);
+            break;
+        default:
+            break;
+        }
+        return n;
+    }
+
+    // Queue a candidate; false if it is already in flight or the queue
+    // is full.
+    bool enqueue(uint64_t line)
+    {
+        for (auto &q : queue) if (q.line == line) return false;
+        if (queue.size() >= QUEUE) { ++dropped_; return false; }
+        queue.push_back({ line, clock + cfg.delay });
+        ++issued_;
+        return true;
+    }
+
+    // A demand miss on a line still in flight: the prefetch was late.
+    bool cancel(uint64_t line)
+    {
+        for (size_t i = 0; i < queue.size(); ++i)
+            if (queue[i].line == line)
+            {
+                queue.erase(queue.begin() + i);
+                ++late_;
+                return true;
+            }
+        return false;
+    }
+
+    // One demand access went by; returns how many prefetches are now due,
+    // written to `ready`.
+    size_t advance(uint64_t *ready)
+    {
+        ++clock;
+        size_t k = 0, n = 0;
+        for (auto &q : queue)
+        {
+            if (q.due <= clock) ready[n++] = q.line;
+            else queue[k++] = q;
+        }
+        queue.resize(k);
+        return n;
+    }
+
+    uint64_t issued()  const { return issued_;  }
+    uint64_t late()    const { return late_;    }
+    uint64_t dropped() const { return dropped_; }
+    void reset_stats()       { issued_ = late_ = dropped_ = 0; }
+
+private:
+    struct Stride  { uint64_t pc, last; int64_t stride; uint32_t conf; };
+    struct Stream  { uint64_t last = 0; int32_t dir = 0; uint32_t conf = 0; uint64_t used = 0; bool valid = false; };
+    struct Pending { uint64_t line, due; };
+
+    // `degree` lines `step` lines apart, starting `distance` steps ahead,
+    // within the trigger's page
+    size_t emit(uint64_t line, int64_t step, uint64_t *out) const
+    {
+        uint64_t page = line & ~(cfg.page - 1);
+        size_t n = 0;
+        for (uint32_t i = 0; i < cfg.degree; ++i)
+        {
+            uint64_t a = line + (uint64_t)(step * (int64_t)((cfg.distance + i) * cfg.blk));
+            if ((a & ~(cfg.page - 1)) != page) break;
+            out[n++] = a;
+        }
+        return n;
+    }
+
+    size_t stream(uint64_t line, uint64_t *out)
+    {
+        ++tick;
+        Stream *victim = &streams[0];
+        for (auto &s : streams)
+        {
+            if (s.valid)
+            {
+                int64_t d = (int64_t)(line - s.last) / (int64_t)cfg.blk;
+                int32_t dir = d > 0 ? 1 : -1;
+                if (d != 0 && (d < 0 ? -d : d) <= (int64_t)WINDOW && (s.dir == 0 || s.dir == dir))
+                {
+                    if (s.dir == dir) { if (s.conf < 3) ++s.conf; }
+                    else s.dir = dir, s.conf = 1;
+                    s.last = line;
+                    s.used = tick;
+                    return s.conf >= 2 ? emit(line, s.dir, out) : 0;
+                }
+            }
+            if (!s.valid || (victim->valid && s.used < victim->used)) victim = &s;
+        }
+        *victim = Stream();
+        victim->last  = line;
+        victim->used  = tick;
+        victim->valid = true;
+        return 0;
+    }
+
+    Config               cfg;
+    std::vector<Stride>  table;
+    std::vector<Stream>  streams;
+    std::vector<Pending> queue;
+    uint64_t             clock = 0, tick = 0;
+    uint64_t             issued_ = 0, late_ = 0, dropped_ = 0;
+};
+
+} // namespace PREFETCH
+
+#endif /* PREFETCH_H */
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdio>       // fopen, fgets, sscanf
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if !defined(PROCFS_H)
+#define PROCFS_H
+
+namespace PROCFS
+{
+
+// ---------------------------------------------------------------------------
+// One VMA as listed by /proc/<pid>/maps. The smaps-only fields stay zero
+// when the mapping came from plain maps.
+// ---------------------------------------------------------------------------
+struct Mapping
+{
+    uint64_t    start, end;       // [start, end)
+    uint64_t    offset;           // file offset
+    uint64_t    inode;            // 0 for anonymous memory
+    char        perms[5];         // e.g. "rw-p"
+    std::string path;             // "", "[heap]", "[stack]", "/lib/..."
+    uint64_t    anon_huge_kb;     // AnonHugePages + Shmem/FilePmdMapped
+    uint64_t    kernel_page_kb;   // KernelPageSize (2048+ for hugetlbfs)
+};
+
+// ---------------------------------------------------------------------------
+// Parse a maps header line "start-end perms offset dev inode [path]".
+// Returns false for anything else (e.g. the "Name: value kB" smaps lines).
+// ---------------------------------------------------------------------------
+inline bool parse_map_line(const char *line, Mapping &m)
+{
+    unsigned long long start, end, offset, inode;
+    char perms[8], dev[16];
+    int  pathPos = 0;
+    if (std::sscanf(line, "%llx-%llx %7s %llx %15s %llu %n",
+                    &start, &end, perms, &offset, dev, &inode, &pathPos) < 6)
+        return false;
+
+    m.start  = start;
+    m.end    = end;
+    m.offset = offset;
+    m.inode  = inode;
+    std::strncpy(m.perms, perms, sizeof(m.perms) - 1);
+    m.perms[sizeof(m.perms) - 1] = '\0';
+
+    m.path = pathPos ? line + pathPos : "";
+    while (!m.path.empty() && (m.path.back() == '\n' || m.path.back() == ' '))
+        m.path.pop_back();
+
+    m.anon_huge_kb   = 0;
+    m.kernel_page_kb = 4;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Read /proc/<pid>/maps, or /proc/<pid>/smaps when `smaps` is set (slower,
+// but reports huge-page backing). Returns false if the file can't be read.
+// ---------------------------------------------------------------------------
+inline bool read_maps(int pid, std::vector<Mapping> &out, bool smaps)
+{
+    char fname[64];
+    std::snprintf(fname, sizeof(fname), "/proc/%d/%s", pid, smaps ? "smaps" : "maps");
+    FILE *f = std::fopen(fname, "r");
+    if (!f) return false;
+
+    out.clear();
+    char line[4096];
+    while (std::fgets(line, sizeof(line), f))
+    {
+        Mapping m;
+        if (parse_map_line(line, m))
+        {
+            out.push_back(m);
+            continue;
+        }
+        if (out.empty()) continue;
+
+        unsigned long long kb;
+        if (std::sscanf(line, "AnonHugePages: %llu kB", &kb) == 1 ||
+            std::sscanf(line, "ShmemPmdMapped: %llu kB", &kb) == 1 ||
+            std::sscanf(line, "FilePmdMapped: %llu kB", &kb) == 1)
+            out.back().anon_huge_kb += kb;
+        else if (std::sscanf(line, "KernelPageSize: %llu kB", &kb) == 1)
+            out.back().kernel_page_kb = kb;
+    }
+    std::fclose(f);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Read /proc/<pid>/statm: total program size and resident set, both in
+// units of the system page size.
+// ---------------------------------------------------------------------------
+inline bool read_statm(int pid, uint64_t &size_pages, uint64_t &rss_pages)
+{
+    char fname[64];
+    std::snprintf(fname, sizeof(fname), "/proc/%d/statm", pid);
+    FILE *f = std::fopen(fname, "r");
+    if (!f) return false;
+
+    unsigned long long sz = 0, rss = 0;
+    bool ok = std::fscanf(f, "%llu %llu", &sz, &rss) == 2;
+    std::fclose(f);
+    size_pages = sz;
+    rss_pages  = rss;
+    return ok;
+}
+
+} // namespace PROCFS
+
+#endif /* PROCFS_H */
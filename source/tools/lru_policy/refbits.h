@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#if !defined(REFBITS_H)
+#define REFBITS_H
+
+namespace REFBITS
+{
+
+// ---------------------------------------------------------------------------
+// One bit per page number, for page-table style flags (present, accessed,
+// dirty). A three-level radix like a page table: TOP_BITS index the root,
+// MID_BITS a directory, and each leaf covers 2^LEAF_BITS pages in 4 KiB of
+// bits. Page numbers of KEY_BITS or more have no bit; they read as clear and
+// setting them is a no-op.
+//
+// Lock free. Directories and leaves are allocated on first set and kept
+// until the bitmap is destroyed, so a set on a page whose leaf exists is a
+// load plus, if the bit was clear, one atomic or.
+// ---------------------------------------------------------------------------
+class Bitmap
+{
+public:
+    static constexpr uint32_t LEAF_BITS = 15;
+    static constexpr uint32_t MID_BITS  = 12;
+    static constexpr uint32_t TOP_BITS  = 13;
+    static constexpr uint32_t KEY_BITS  = LEAF_BITS + MID_BITS + TOP_BITS;
+
+    Bitmap() { for (auto &d : root) d.store(nullptr, std::memory_order_relaxed); }
+    ~Bitmap()
+    {
+        for (auto &d : root)
+        {
+            Dir *dir = d.load(std::memory_order_relaxed);
+            if (!dir) continue;
+            for (auto &l : dir->leaf) delete l.load(std::memory_order_relaxed);
+            delete dir;
+        }
+    }
+    Bitmap(const Bitmap &) = delete;
+    Bitmap &operator=(const Bitmap &) = delete;
+
+    bool test(uint64_t page) const
+    {
+        const std::atomic<uint64_t> *w = word(page);
+        return w && (w->load(std::memory_order_relaxed) & bit(page));
+    }
+
+    void set(uint64_t page)
+    {
+        std::atomic<uint64_t> *w = word(page, true);
+        if (w && !(w->load(std::memory_order_relaxed) & bit(page)))
+            w->fetch_or(bit(page), std::memory_order_relaxed);
+    }
+
+    void clear(uint64_t page)
+    {
+        std::atomic<uint64_t> *w = word(page);
+        if (w && (w->load(std::memory_order_relaxed) & bit(page)))
+            w->fetch_and(~bit(page), std::memory_order_relaxed);
+    }
+
+    // Clear and return the bit, as a scanner does with the accessed bit.
+    bool test_and_clear(uint64_t page)
+    {
+        std::atomic<uint64_t> *w = word(page);
+        if (!w || !(w->load(std::memory_order_relaxed) & bit(page))) return false;
+        return w->fetch_and(~bit(page), std::memory_order_relaxed) & bit(page);
+    }
+
+    // Clear [lo, hi), skipping nodes that were never allocated.
+    void clear_range(uint64_t lo, uint64_t hi)
+    {
+        if (hi > (1ULL << KEY_BITS)) hi = 1ULL << KEY_BITS;
+        while (lo < hi)
+        {
+            uint32_t span = root[lo >> (LEAF_BITS + MID_BITS)].load(std::memory_order_acquire)
+                          ? LEAF_BITS : LEAF_BITS + MID_BITS;
+            uint64_t end = ((lo >> span) + 1) << span;
+            if (end > hi) end = hi;
+            if (!word(lo))
+            {
+                lo = end;
+                continue;
+            }
+            for (; lo < end && (lo & 63); ++lo) clear(lo);
+            for (; lo + 64 <= end; lo += 64)
+                word(lo)->store(0, std::memory_order_relaxed);
+            for (; lo < end; ++lo) clear(lo);
+        }
+    }
+
+private:
+    static constexpr uint64_t LEAF_WORDS = (1ULL << LEAF_BITS) / 64;
+
+    struct Leaf { std::atomic<uint64_t> w[LEAF_WORDS] = {}; };
+    struct Dir  { std::atomic<Leaf*> leaf[1ULL << MID_BITS] = {}; };
+
+    static uint64_t bit(uint64_t page) { return 1ULL << (page & 63); }
+
+    // Install a zeroed node unless another thread got there first.
+    template <class T>
+    static T *get(std::atomic<T*> &slot, bool create)
+    {
+        T *p = slot.load(std::memory_order_acquire);
+        if (p || !create) return p;
+        T *fresh = new T();
+        if (slot.compare_exchange_strong(p, fresh, std::memory_order_acq_rel))
+            return fresh;
+        delete fresh;
+        return p;
+    }
+
+    std::atomic<uint64_t> *word(uint64_t page, bool create = false) const
+    {
+        if (page >> KEY_BITS) return nullptr;
+        auto &slot = const_cast<std::atomic<Dir*>&>(root[page >> (LEAF_BITS + MID_BITS)]);
+        Dir *dir = get(slot, create);
+        if (!dir) return nullptr;
+        Leaf *leaf = get(dir->leaf[(page >> LEAF_BITS) & ((1ULL << MID_BITS) - 1)], create);
+        if (!leaf) return nullptr;
+        return &leaf->w[(page & ((1ULL << LEAF_BITS) - 1)) / 64];
+    }
+
+    std::atomic<Dir*> root[1ULL << TOP_BITS];
+};
+
+} // namespace REFBITS
+
+#endif /* REFBITS_H */
@@ -0,0 +1,55 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include "refbits.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Set / test / clear                o
+// test_and_clear consumes the bit   o
+// Leaves and directories are apart  o
+// clear_range, partial words        o
+// Out-of-range pages are ignored    o
+// -----------------------------------------------------------------------
+
+using namespace REFBITS;
+
+int main()
+{
+    std::unique_ptr<Bitmap> b(new Bitmap);
+
+    assert(!b->test(0) && !b->test_and_clear(0));
+    b->set(5);
+    b->set(5);
+    assert(b->test(5) && !b->test(4) && !b->test(6));
+    b->clear(5);
+    assert(!b->test(5));
+
+    b->set(77);
+    assert(b->test_and_clear(77) && !b->test(77) && !b->test_and_clear(77));
+
+    // neighbours across a leaf and a directory boundary
+    const uint64_t leaf = 1ULL << Bitmap::LEAF_BITS;
+    const uint64_t last = (1ULL << Bitmap::KEY_BITS) - 1;
+    const uint64_t dir  = 1ULL << (Bitmap::LEAF_BITS + Bitmap::MID_BITS);
+    for (uint64_t p : { leaf - 1, leaf, dir - 1, dir, last })
+        b->set(p);
+    assert(b->test(leaf - 1) && b->test(leaf) && b->test(dir - 1) && b->test(dir));
+    assert(b->test(last) && !b->test(leaf + 1));
+
+    // a range spanning partial words, whole words and two leaves
+    for (uint64_t p = leaf - 100; p < leaf + 100; ++p) b->set(p);
+    b->clear_range(leaf - 90, leaf + 70);
+    for (uint64_t p = leaf - 100; p < leaf + 100; ++p)
+        assert(b->test(p) == (p < leaf - 90 || p >= leaf + 70));
+
+    // the whole key space: unallocated leaves are skipped
+    b->clear_range(0, ~0ULL);
+    assert(!b->test(leaf - 100) && !b->test(dir) && !b->test(last));
+
+    b->set(1ULL << Bitmap::KEY_BITS);
+    assert(!b->test(1ULL << Bitmap::KEY_BITS));
+
+    std::cout << "refbits ok" << std::endl;
+    return 0;
+}
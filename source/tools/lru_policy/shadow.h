@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(SHADOW_H)
+#define SHADOW_H
+
+namespace SHADOW
+{
+
+// ---------------------------------------------------------------------------
+// Refault distances in log2 buckets: bucket 0 holds distance 0, bucket k
+// holds [2^(k-1), 2^k).
+// ---------------------------------------------------------------------------
+struct Histogram
+{
+    static constexpr uint32_t BUCKETS = 65;
+
+    uint64_t bucket[BUCKETS] = {};
+    uint64_t total = 0;
+
+    static uint32_t index(uint64_t d) { return d ? 64 - __builtin_clzll(d) : 0; }
+
+    void add(uint64_t d) { ++bucket[index(d)]; ++total; }
+};
+
+// ---------------------------------------------------------------------------
+// Shadow entries in the style of Linux mm/workingset.c. When a tier evicts
+// a page it records the tier's eviction clock; if the page comes back, the
+// number of evictions since, its own included, is its refault distance:
+// an LRU tier that many pages larger would still have held it.
+//
+// At most `cap` entries are kept, 12 bytes of payload each: a 32-bit
+// timestamp (distances are taken modulo 2^32, like the kernel's packed
+// eviction counter) and a slot in a FIFO ring that reclaims the oldest
+// shadow first.
+// ---------------------------------------------------------------------------
+class Table
+{
+public:
+    explicit Table(uint32_t capacity) : ring(capacity ? capacity : 1, EMPTY) {}
+
+    // `page` left the tier; advances the clock.
+    void evict(uint64_t page)
+    {
+        uint32_t slot = head;
+        head = (head + 1) % ring.size();
+        uint64_t old = ring[slot];
+        if (old != EMPTY)
+        {
+            auto it = shadows.find(old);
+            if (it != shadows.end() && it->second.slot == slot)
+            {
+                shadows.erase(it);
+                ++dropped_;
+            }
+        }
+        ring[slot] = page;
+        shadows[page] = { (uint32_t)clock, slot };
+        ++clock;
+    }
+
+    // A page not in the tier is referenced. True if it has a shadow; the
+    // shadow is consumed and the distance returned.
+    bool refault(uint64_t page, uint64_t &distance)
+    {
+        auto it = shadows.find(page);
+        if (it == shadows.end()) return false;
+        distance = (uint32_t)((uint32_t)clock - it->second.age);
+        shadows.erase(it);
+        hist.add(distance);
+        return true;
+    }
+
+    // The pages' memory was released.
+    void discard(uint64_t lo, uint64_t hi)
+    {
+        if (hi - lo <= shadows.size())
+        {
+            for (uint64_t p = lo; p < hi; ++p) shadows.erase(p);
+            return;
+        }
+        for (auto it = shadows.begin(); it != shadows.end(); )
+            it = (it->first >= lo && it->first < hi) ? shadows.erase(it) : ++it;
+    }
+
+    // Live shadows, oldest first, as (page, timestamp).
+    template <class F>
+    void for_each(F f) const
+    {
+        for (size_t i = 0; i < ring.size(); ++i)
+        {
+            uint32_t slot = (uint32_t)((head + i) % ring.size());
+            auto it = shadows.find(ring[slot]);
+            if (ring[slot] != EMPTY && it != shadows.end() && it->second.slot == slot)
+                f(ring[slot], it->second.age);
+        }
+    }
+
+    // Re-record a shadow with its old timestamp (checkpoint restore).
+    void restore(uint64_t page, uint32_t age)
+    {
+        uint64_t saved = clock;
+        clock = age;
+        evict(page);
+        clock = saved;
+    }
+
+    size_t           size()      const { return shadows.size(); }
+    uint64_t         evictions() const { return clock; }
+    uint64_t         dropped()   const { return dropped_; }
+    const Histogram& histogram() const { return hist; }
+
+    void set_state(uint64_t evictions, uint64_t dropped, const Histogram &h)
+    {
+        clock = evictions; dropped_ = dropped; hist = h;
+    }
+    void reset_stats() { dropped_ = 0; hist = Histogram(); }
+
+private:
+    static constexpr uint64_t EMPTY = ~0ULL;
+    struct Shadow { uint32_t age, slot; };
+
+    std::vector<uint64_t>                ring;
+    uint32_t                             head = 0;
+    std::unordered_map<uint64_t, Shadow> shadows;
+    uint64_t                             clock = 0, dropped_ = 0;
+    Histogram                            hist;
+};
+
+} // namespace SHADOW
+
+#endif /* SHADOW_H */
@@ -0,0 +1,60 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "shadow.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Distance counts evictions since   o
+// Shadow consumed on refault        o
+// Ring drops the oldest shadow      o
+// Re-eviction refreshes a shadow    o
+// Discard / restore order           o
+// Log2 buckets                      o
+// -----------------------------------------------------------------------
+
+using namespace SHADOW;
+
+int main()
+{
+    assert(Histogram::index(0) == 0 && Histogram::index(1) == 1);
+    assert(Histogram::index(3) == 2 && Histogram::index(4) == 3);
+
+    Table t(4);
+    uint64_t d;
+    assert(!t.refault(1, d));
+    t.evict(1);
+    assert(t.refault(1, d) && d == 1);              // one page more would do
+    assert(!t.refault(1, d));                       // consumed
+
+    t.evict(1); t.evict(2); t.evict(3);
+    assert(t.refault(1, d) && d == 3);
+    assert(t.histogram().total == 2 && t.histogram().bucket[1] == 1 &&
+           t.histogram().bucket[2] == 1);
+
+    // four slots: 4, 5, 6 reuse the slots of 1, 1 (both consumed) and 2
+    t.evict(4); t.evict(5); t.evict(6);
+    assert(!t.refault(2, d) && t.dropped() == 1 && t.size() == 4);
+
+    // evicting 4 again refreshes its shadow (and pushes 3 out); its old
+    // slot no longer drops it
+    t.evict(4);
+    assert(t.dropped() == 2);
+    t.evict(7); t.evict(8); t.evict(9);
+    assert(t.refault(4, d) && d == 4 && t.evictions() == 11);
+
+    std::vector<uint64_t> order;
+    t.for_each([&](uint64_t p, uint32_t) { order.push_back(p); });
+    assert((order == std::vector<uint64_t>{ 7, 8, 9 }));
+
+    Table r(4);
+    t.for_each([&](uint64_t p, uint32_t age) { r.restore(p, age); });
+    r.set_state(t.evictions(), t.dropped(), t.histogram());
+    assert(r.refault(7, d) && d == 3);
+
+    r.discard(0, 100);
+    assert(r.size() == 0);
+
+    std::cout << "shadow ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>      // abort
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <fcntl.h>      // open
+#include <unistd.h>     // ftruncate, close, unlink
+#include <sys/mman.h>   // mmap
+
+#if !defined(SHMARENA_H)
+#define SHMARENA_H
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+namespace SHMARENA
+{
+
+// ---------------------------------------------------------------------------
+// Spin lock usable across processes (lives inside the shared segment).
+// ---------------------------------------------------------------------------
+struct SpinLock
+{
+    std::atomic<uint32_t> v{0};
+
+    void lock()
+    {
+        while (v.exchange(1, std::memory_order_acquire))
+            while (v.load(std::memory_order_relaxed))
+                __builtin_ia32_pause();
+    }
+    void unlock() { v.store(0, std::memory_order_release); }
+};
+
+// ---------------------------------------------------------------------------
+// Bump allocator with per-size-class free lists, placed at the start of a
+// shared mapping. Every process maps the segment at the same address, so
+// ordinary pointers (list links, unordered_map internals) stay valid.
+// Callers pass the size back on deallocate, as std allocators do, so blocks
+// carry no header.
+// ---------------------------------------------------------------------------
+struct Arena
+{
+    static constexpr uint64_t MAGIC    = 0x6c72757368617265ULL;   // "lrushare"
+    static constexpr uint32_t NCLASS   = 48;
+    static constexpr uint32_t NROOTS   = 8;
+    static constexpr uint32_t NLOCKS   = 8;
+
+    uint64_t              magic;
+    uint64_t              base;        // address every process maps at
+    uint64_t              size;        // bytes in the segment
+    std::atomic<uint64_t> top;         // bump offset
+    std::atomic<int32_t>  refs;        // attached processes
+    SpinLock              alloc_lock;
+    uint64_t              free_head[NCLASS];
+    void*                 roots[NROOTS];  // user objects (e.g. the page lists)
+    SpinLock              locks[NLOCKS];  // user locks
+
+    // Size classes: 16-byte steps up to 512, then powers of two.
+    static uint32_t size_class(size_t n, size_t &rounded)
+    {
+        if (n <= 512)
+        {
+            rounded = (n + 15) & ~size_t(15);
+            return uint32_t(rounded / 16);                 // 1..32
+        }
+        uint32_t lg = 64 - __builtin_clzll(n - 1);       // >= 10
+        rounded = size_t(1) << lg;
+        return 33 + (lg - 10);
+    }
+
+    void* allocate(size_t n)
+    {
+        size_t   rounded;
+        uint32_t c = size_class(n ? n : 1, rounded);
+
+        alloc_lock.lock();
+        uint64_t off = c < NCLASS ? free_head[c] : 0;
+        if (off)
+        {
+            std::memcpy(&free_head[c], reinterpret_cast<char*>(base) + off, sizeof(uint64_t));
+        }
+        else
+        {
+            off = top.load(std::memory_order_relaxed);
+            if (off + rounded > size)
+            {
+                alloc_lock.unlock();
+                std::fprintf(stderr, "SHMARENA: shared segment exhausted (%llu bytes)\n",
+                             (unsigned long long)size);
+                std::abort();
+            }
+            top.store(off + rounded, std::memory_order_relaxed);
+        }
+        alloc_lock.unlock();
+        return reinterpret_cast<char*>(base) + off;
+    }
+
+    void deallocate(void *p, size_t n)
+    {
+        size_t   rounded;
+        uint32_t c = size_class(n ? n : 1, rounded);
+        if (c >= NCLASS) return;                           // leak oversized blocks
+        uint64_t off = reinterpret_cast<char*>(p) - reinterpret_cast<char*>(base);
+
+        alloc_lock.lock();
+        std::memcpy(p, &free_head[c], sizeof(uint64_t));
+        free_head[c] = off;
+        alloc_lock.unlock();
+    }
+
+    // -----------------------------------------------------------------------
+    // Create a segment named /dev/shm/<name> of `bytes` bytes, preferably at
+    // `hint`. Returns nullptr on failure.
+    // -----------------------------------------------------------------------
+    static Arena* create(const char *name, uint64_t bytes, uint64_t hint)
+    {
+        char path[256];
+        std::snprintf(path, sizeof(path), "/dev/shm/%s", name);
+        int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) return nullptr;
+        if (ftruncate(fd, (off_t)bytes) != 0) { close(fd); unlink(path); return nullptr; }
+
+        void *p = MAP_FAILED;
+        if (hint)
+        {
+            p = mmap(reinterpret_cast<void*>(hint), bytes, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+            if (p != MAP_FAILED && p != reinterpret_cast<void*>(hint))
+            {
+                munmap(p, bytes);          // kernel took it as a plain hint
+                p = MAP_FAILED;
+            }
+        }
+        if (p == MAP_FAILED)
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) { unlink(path); return nullptr; }
+
+        Arena *a = new (p) Arena();
+        a->magic = MAGIC;
+        a->base  = reinterpret_cast<uint64_t>(p);
+        a->size  = bytes;
+        a->top.store((sizeof(Arena) + 63) & ~uint64_t(63));
+        a->refs.store(1);
+        std::memset(a->free_head, 0, sizeof(a->free_head));
+        std::memset(a->roots, 0, sizeof(a->roots));
+        return a;
+    }
+
+    // -----------------------------------------------------------------------
+    // Map an existing segment at the address its creator used. Fails (and
+    // returns nullptr) if that address is taken in this process.
+    // -----------------------------------------------------------------------
+    static Arena* attach(const char *name)
+    {
+        char path[256];
+        std::snprintf(path, sizeof(path), "/dev/shm/%s", name);
+        int fd = open(path, O_RDWR);
+        if (fd < 0) return nullptr;
+
+        Arena hdr;
+        if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || hdr.magic != MAGIC)
+        {
+            close(fd);
+            return nullptr;
+        }
+        void *p = mmap(reinterpret_cast<void*>(hdr.base), hdr.size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return nullptr;
+        if (p != reinterpret_cast<void*>(hdr.base)) { munmap(p, hdr.size); return nullptr; }
+
+        Arena *a = reinterpret_cast<Arena*>(p);
+        a->refs.fetch_add(1);
+        return a;
+    }
+
+    // -----------------------------------------------------------------------
+    // Drop this process's reference; the last one out removes the segment.
+    // The mapping itself stays until exit, so late readers don't fault.
+    // -----------------------------------------------------------------------
+    static void detach(Arena *a, const char *name)
+    {
+        if (a->refs.fetch_sub(1) == 1)
+        {
+            char path[256];
+            std::snprintf(path, sizeof(path), "/dev/shm/%s", name);
+            unlink(path);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// std allocator over an Arena; a null arena means the ordinary heap.
+// ---------------------------------------------------------------------------
+template<typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+    Arena *arena;
+
+    ArenaAllocator(Arena *a = nullptr) : arena(a) {}
+    template<typename U> ArenaAllocator(const ArenaAllocator<U> &o) : arena(o.arena) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(arena ? arena->allocate(n * sizeof(T))
+                                     : ::operator new(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t n)
+    {
+        if (arena) arena->deallocate(p, n * sizeof(T));
+        else       ::operator delete(p);
+    }
+
+    template<typename U> bool operator==(const ArenaAllocator<U> &o) const { return arena == o.arena; }
+    template<typename U> bool operator!=(const ArenaAllocator<U> &o) const { return arena != o.arena; }
+};
+
+} // namespace SHMARENA
+
+#endif /* SHMARENA_H */
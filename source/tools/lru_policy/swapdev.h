@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#if !defined(SWAPDEV_H)
+#define SWAPDEV_H
+
+namespace SWAPDEV
+{
+
+// ---------------------------------------------------------------------------
+// Device parameters, in the simulator's latency unit. `bw` is bytes per
+// unit; 0 means transfers are free and only the fixed latency counts.
+// ---------------------------------------------------------------------------
+struct Config
+{
+    double   read_lat  = 200000;
+    double   bw        = 1.0;
+    uint64_t slots     = 0;         // swap capacity in pages, 0 = unbounded
+};
+
+struct Stats
+{
+    uint64_t writes = 0, written = 0;       // pages, bytes written back
+    uint64_t reads = 0, read_bytes = 0;     // major faults, bytes read
+    uint64_t dropped = 0;                   // writebacks refused when full
+    double   stall = 0;                     // total fault latency
+    double   wait  = 0;                     // ... of which queueing
+};
+
+// ---------------------------------------------------------------------------
+// Swap device below the compressed pool (zswap writeback). It remembers
+// which pages were written out and serves them back as major faults.
+//
+// One FIFO queue: each I/O starts when both it arrives and the device is
+// free, then holds the device for bytes / bw. Writebacks are asynchronous,
+// so they cost the application nothing directly, but a fault queued behind
+// them waits. `now` is the caller's clock, in the same unit.
+// ---------------------------------------------------------------------------
+class Device
+{
+public:
+    explicit Device(const Config &c = Config()) : cfg(c) {}
+
+    // Write a page out. False if the device is full and the page is lost
+    // (counted as dropped).
+    bool write(uint64_t page, uint32_t bytes, double now)
+    {
+        auto it = pages.find(page);
+        if (it == pages.end() && cfg.slots && pages.size() >= cfg.slots)
+        {
+            ++st.dropped;
+            return false;
+        }
+        occupy(bytes, now);
+        pages[page] = bytes;
+        ++st.writes;
+        st.written += bytes;
+        return true;
+    }
+
+    bool contains(uint64_t page) const { return pages.count(page) != 0; }
+
+    // Read a page back in and free its slot. Returns the fault's latency
+    // (queueing + fixed latency + transfer), or a negative value if the
+    // page is not on the device.
+    double read(uint64_t page, double now)
+    {
+        auto it = pages.find(page);
+        if (it == pages.end()) return -1;
+        uint32_t bytes = it->second;
+        pages.erase(it);
+        double wait = occupy(bytes, now);
+        double lat  = wait + cfg.read_lat + transfer(bytes);
+        ++st.reads;
+        st.read_bytes += bytes;
+        st.wait  += wait;
+        st.stall += lat;
+        return lat;
+    }
+
+    // The pages' memory was released; their slots go without any I/O.
+    void discard(uint64_t lo, uint64_t hi)
+    {
+        if (hi - lo <= pages.size())
+        {
+            for (uint64_t p = lo; p < hi; ++p) pages.erase(p);
+            return;
+        }
+        for (auto it = pages.begin(); it != pages.end(); )
+            it = (it->first >= lo && it->first < hi) ? pages.erase(it) : ++it;
+    }
+
+    // Put a page back without I/O (checkpoint restore).
+    void restore(uint64_t page, uint32_t bytes) { pages[page] = bytes; }
+
+    template <class F>
+    void for_each(F f) const { for (auto &p : pages) f(p.first, p.second); }
+
+    size_t       size()  const { return pages.size(); }
+    const Stats& stats() const { return st; }
+    void set_stats(const Stats &s) { st = s; }
+    void reset_stats() { st = Stats(); }
+
+private:
+    double transfer(uint32_t bytes) const { return cfg.bw > 0 ? bytes / cfg.bw : 0; }
+
+    // Queue an I/O arriving at `now`; returns how long it waited.
+    double occupy(uint32_t bytes, double now)
+    {
+        double start = busy > now ? busy : now;
+        busy = start + transfer(bytes);
+        return start - now;
+    }
+
+    Config                                 cfg;
+    std::unordered_map<uint64_t, uint32_t> pages;   // page -> bytes on device
+    double                                 busy = 0;
+    Stats                                  st;
+};
+
+} // namespace SWAPDEV
+
+#endif /* SWAPDEV_H */
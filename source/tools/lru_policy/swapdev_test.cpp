@@ -0,0 +1,48 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include "swapdev.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Write then fault back         o
+// Fault queues behind writeback o
+// Slot limit drops pages        o
+// Discard frees without I/O     o
+// -----------------------------------------------------------------------
+
+using namespace SWAPDEV;
+
+int main()
+{
+    Config c;
+    c.read_lat = 100; c.bw = 4.0; c.slots = 2;
+    Device d(c);
+
+    assert(d.read(7, 0) < 0);                       // never written
+    assert(d.write(7, 4096, 0));                    // busy until 1024
+    assert(d.contains(7) && d.size() == 1 && d.stats().written == 4096);
+
+    // the fault arrives at 24 and waits 1000 for the writeback to drain
+    double lat = d.read(7, 24);
+    assert(lat == 1000 + 100 + 1024);
+    assert(d.stats().wait == 1000 && d.stats().stall == lat && !d.contains(7));
+
+    // an idle device: fixed latency plus transfer only
+    d.write(8, 4096, 10000);
+    assert(d.read(8, 20000) == 100 + 1024);
+
+    assert(d.write(1, 4096, 30000) && d.write(2, 4096, 30000));
+    assert(!d.write(3, 4096, 30000) && d.stats().dropped == 1);
+    assert(d.write(2, 4096, 40000));                // rewriting keeps its slot
+    d.discard(0, 2);
+    assert(d.size() == 1 && d.stats().reads == 2 && d.stats().writes == 5);
+    d.restore(9, 100);
+    d.discard(0, 1ULL << 40);                       // wide range: scans
+    assert(d.size() == 0);
+
+    d.reset_stats();
+    assert(d.stats().reads == 0 && d.stats().stall == 0);
+
+    std::cout << "swapdev ok" << std::endl;
+    return 0;
+}
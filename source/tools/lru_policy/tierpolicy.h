@@ -0,0 +1,896 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(TIERPOLICY_H)
+#define TIERPOLICY_H
+
+namespace TIERPOLICY
+{
+
+// ---------------------------------------------------------------------------
+// Replacement policy for the uncompressed page tier. A policy only decides
+// which virtual page numbers stay resident; the simulator keeps the byte
+// accounting, the compressed tier beneath and the locking.
+//
+// Every operation is O(1) amortized except resident(), which walks the
+// resident set, and remove_range() over a range wider than the set.
+// ---------------------------------------------------------------------------
+class PageTierPolicy
+{
+public:
+    explicit PageTierPolicy(size_t capacity) : cap(capacity ? capacity : 1) {}
+    virtual ~PageTierPolicy() {}
+
+    virtual const char* name() const = 0;
+
+    // Reference `page`. Returns true on a hit. A miss admits the page; if
+    // the tier was full one resident page leaves and is written to `victim`
+    // with `evicted` set.
+    virtual bool access(uint64_t page, uint64_t &victim, bool &evicted) = 0;
+
+    virtual bool contains(uint64_t page) const = 0;
+
+    // Forget a page (unmapped). Non-resident history goes too.
+    virtual void remove(uint64_t page) = 0;
+
+    virtual size_t size() const = 0;
+
+    virtual void resident(std::vector<uint64_t> &out) const = 0;
+
+    size_t capacity() const { return cap; }
+
+    // Change the capacity; pages pushed out are appended to `victims`.
+    void resize(size_t capacity, std::vector<uint64_t> &victims)
+    {
+        cap = capacity ? capacity : 1;
+        resized();
+        uint64_t v;
+        while (size() > cap && evict(v)) victims.push_back(v);
+    }
+
+    // Remove every page in [lo, hi).
+    void remove_range(uint64_t lo, uint64_t hi)
+    {
+        if (hi <= lo) return;
+        if (hi - lo <= size())
+        {
+            for (uint64_t p = lo; p < hi; ++p) remove(p);
+            return;
+        }
+        std::vector<uint64_t> in;
+        resident(in);
+        for (uint64_t p : in)
+            if (p >= lo && p < hi) remove(p);
+    }
+
+protected:
+    // Push one resident page out; false when nothing is resident.
+    virtual bool evict(uint64_t &victim) = 0;
+    // The capacity changed; recompute derived targets.
+    virtual void resized() {}
+
+    size_t cap;
+};
+
+// ---------------------------------------------------------------------------
+// CLOCK: frames in a ring with a reference bit; the hand clears set bits
+// and takes the first page whose bit is already clear.
+// ---------------------------------------------------------------------------
+class Clock : public PageTierPolicy
+{
+public:
+    explicit Clock(size_t capacity) : PageTierPolicy(capacity) {}
+
+    const char* name() const override { return "clock"; }
+
+    bool access(uint64_t page, uint64_t &victim, bool &evicted) override
+    {
+        evicted = false;
+        auto it = where.find(page);
+        if (it != where.end()) { frames[it->second].ref = true; return true; }
+        if (where.size() >= cap) evicted = evict(victim);
+        size_t slot;
+        if (!spare.empty()) { slot = spare.back(); spare.pop_back(); }
+        else { slot = frames.size(); frames.push_back(Frame()); }
+        frames[slot] = { page, true, true };
+        where[page] = slot;
+        return false;
+    }
+
+    bool contains(uint64_t page) const override { return where.count(page) != 0; }
+
+    void remove(uint64_t page) override
+    {
+        auto it = where.find(page);
+        if (it == where.end()) return;
+        frames[it->second].used = false;
+        spare.push_back(it->second);
+        where.erase(it);
+    }
+
+    size_t size() const override { return where.size(); }
+
+    void resident(std::vector<uint64_t> &out) const override
+    {
+        for (auto &w : where) out.push_back(w.first);
+    }
+
+protected:
+    bool evict(uint64_t &victim) override
+    {
+        if (where.empty()) return false;
+        for (;;)
+        {
+            Frame &f = frames[hand];
+            size_t at = hand;
+            hand = (hand + 1) % frames.size();
+            if (!f.used) continue;
+            if (f.ref) { f.ref = false; continue; }
+            victim = f.page;
+            f.used = false;
+            spare.push_back(at);
+            where.erase(victim);
+            return true;
+        }
+    }
+
+private:
+    struct Frame { uint64_t page = 0; bool ref = false; bool used = false; };
+
+    std::vector<Frame>                   frames;
+    std::vector<size_t>                  spare;
+    std::unordered_map<uint64_t, size_t> where;
+    size_t                               hand = 0;
+};
+
+// ---------------------------------------------------------------------------
+// CLOCK-Pro (Jiang, Chen, Zhang 2005). One ring holds hot and cold resident
+// pages plus cold pages that left memory but are still in their test
+// period. A cold page re-referenced during its test period turns hot; the
+// cold target `mc` grows on such refaults and shrinks when a test period
+// ends without one. Three hands:
+//   cold  finds the victim among resident cold pages
+//   hot   demotes an unreferenced hot page when there are too many
+//   test  trims non-resident pages beyond `cap`
+// ---------------------------------------------------------------------------
+class ClockPro : public PageTierPolicy
+{
+public:
+    explicit ClockPro(size_t capacity) : PageTierPolicy(capacity) { resized(); }
+
+    const char* name() const override { return "clockpro"; }
+
+    bool access(uint64_t page, uint64_t &victim, bool &evicted) override
+    {
+        evicted = false;
+        auto it = where.find(page);
+        if (it != where.end() && it->second->resident)
+        {
+            it->second->ref = true;
+            return true;
+        }
+        if (nhot + ncold >= cap) evicted = evict(victim);
+
+        it = where.find(page);                  // the cold hand may trim it
+        if (it != where.end())
+        {
+            // refault within the test period: more room for cold pages
+            Iter n = it->second;
+            if (mc < cap - 1) ++mc;
+            n->resident = true; n->hot = true; n->test = false; n->ref = false;
+            --nnonres; ++nhot;
+            to_head(n);
+            while (nhot > hot_target()) run_hot();
+        }
+        else
+        {
+            Node n = { page, false, true, true, false };
+            where[page] = insert(n);
+            ++ncold;
+        }
+        return false;
+    }
+
+    bool contains(uint64_t page) const override
+    {
+        auto it = where.find(page);
+        return it != where.end() && it->second->resident;
+    }
+
+    void remove(uint64_t page) override
+    {
+        auto it = where.find(page);
+        if (it == where.end()) return;
+        Iter n = it->second;
+        if (!n->resident) --nnonres;
+        else if (n->hot) --nhot;
+        else --ncold;
+        erase(n);
+    }
+
+    size_t size() const override { return nhot + ncold; }
+
+    void resident(std::vector<uint64_t> &out) const override
+    {
+        for (auto &n : ring) if (n.resident) out.push_back(n.page);
+    }
+
+protected:
+    bool evict(uint64_t &victim) override
+    {
+        if (!nhot && !ncold) return false;
+        if (!ncold) run_hot();
+        for (;;)
+        {
+            Iter n = hand_cold;
+            hand_cold = next(hand_cold);
+            if (n->hot || !n->resident) continue;
+            if (!n->ref)
+            {
+                victim = n->page;
+                --ncold;
+                if (n->test) { n->resident = false; ++nnonres; }
+                else erase(n);
+                while (nnonres > cap) run_test();
+                return true;
+            }
+            n->ref = false;
+            if (n->test)
+            {
+                n->hot = true; n->test = false;
+                --ncold; ++nhot;
+                to_head(n);
+                while (nhot > hot_target()) run_hot();
+                if (!ncold) run_hot();
+            }
+            else
+            {
+                n->test = true;
+                to_head(n);
+            }
+        }
+    }
+
+    void resized() override
+    {
+        if (!mc) mc = cap / 100 ? cap / 100 : 1;
+        if (mc > cap - 1) mc = cap > 1 ? cap - 1 : 1;
+    }
+
+private:
+    struct Node { uint64_t page; bool hot, resident, test, ref; };
+    typedef std::list<Node>::iterator Iter;
+
+    size_t hot_target() const { return cap > mc ? cap - mc : 0; }
+
+    Iter next(Iter i)
+    {
+        if (++i == ring.end()) i = ring.begin();
+        return i;
+    }
+
+    // The list head is just behind the hot hand: the last place it reaches.
+    Iter insert(const Node &n)
+    {
+        if (ring.empty())
+        {
+            ring.push_back(n);
+            hand_hot = hand_cold = hand_test = ring.begin();
+            return ring.begin();
+        }
+        return ring.insert(hand_hot, n);
+    }
+
+    void to_head(Iter n)
+    {
+        if (n == hand_hot) return;
+        ring.splice(hand_hot, ring, n);
+    }
+
+    void erase(Iter n)
+    {
+        where.erase(n->page);
+        if (ring.size() == 1) { ring.clear(); return; }
+        if (hand_hot  == n) hand_hot  = next(n);
+        if (hand_cold == n) hand_cold = next(n);
+        if (hand_test == n) hand_test = next(n);
+        ring.erase(n);
+    }
+
+    // A cold page's test period ended without a refault.
+    void end_test(Iter n)
+    {
+        n->test = false;
+        if (mc > 1) --mc;
+    }
+
+    void run_hot()
+    {
+        while (nhot)
+        {
+            Iter n = hand_hot;
+            hand_hot = next(hand_hot);
+            if (n->hot)
+            {
+                if (n->ref) { n->ref = false; continue; }
+                n->hot = false;
+                --nhot; ++ncold;
+                return;
+            }
+            if (n->test)
+            {
+                end_test(n);
+                if (!n->resident) { --nnonres; erase(n); }
+            }
+        }
+    }
+
+    void run_test()
+    {
+        while (nnonres)
+        {
+            Iter n = hand_test;
+            hand_test = next(hand_test);
+            if (n->hot || !n->test) continue;
+            end_test(n);
+            if (!n->resident) { --nnonres; erase(n); return; }
+        }
+    }
+
+    std::list<Node>                    ring;
+    std::unordered_map<uint64_t, Iter> where;
+    Iter                               hand_hot, hand_cold, hand_test;
+    size_t                             nhot = 0, ncold = 0, nnonres = 0;
+    size_t                             mc = 0;
+};
+
+// ---------------------------------------------------------------------------
+// 2Q (Johnson, Shasha 1994), full version. New pages enter the A1in FIFO
+// (25% of the tier); pages pushed out of it are remembered in the A1out
+// ghost FIFO (50%), and a refault from there goes to the Am LRU. A single
+// sequential scan never gets past A1in.
+// ---------------------------------------------------------------------------
+class TwoQ : public PageTierPolicy
+{
+public:
+    explicit TwoQ(size_t capacity) : PageTierPolicy(capacity) { resized(); }
+
+    const char* name() const override { return "2q"; }
+
+    bool access(uint64_t page, uint64_t &victim, bool &evicted) override
+    {
+        evicted = false;
+        auto it = where.find(page);
+        if (it != where.end())
+        {
+            Ref &r = it->second;
+            if (r.q == AM) { am.splice(am.begin(), am, r.it); return true; }
+            if (r.q == A1IN) return true;
+        }
+        if (a1in.size() + am.size() >= cap) evicted = evict(victim);
+        it = where.find(page);
+        if (it != where.end())
+        {
+            a1out.erase(it->second.it);
+            am.push_front(page);
+            it->second = { AM, am.begin() };
+        }
+        else
+        {
+            a1in.push_front(page);
+            where[page] = { A1IN, a1in.begin() };
+        }
+        return false;
+    }
+
+    bool contains(uint64_t page) const override
+    {
+        auto it = where.find(page);
+        return it != where.end() && it->second.q != A1OUT;
+    }
+
+    void remove(uint64_t page) override
+    {
+        auto it = where.find(page);
+        if (it == where.end()) return;
+        list(it->second.q).erase(it->second.it);
+        where.erase(it);
+    }
+
+    size_t size() const override { return a1in.size() + am.size(); }
+
+    void resident(std::vector<uint64_t> &out) const override
+    {
+        out.insert(out.end(), a1in.begin(), a1in.end());
+        out.insert(out.end(), am.begin(), am.end());
+    }
+
+protected:
+    bool evict(uint64_t &victim) override
+    {
+        if (a1in.empty() && am.empty()) return false;
+        if (a1in.size() > kin || am.empty())
+        {
+            victim = a1in.back();
+            a1in.pop_back();
+            a1out.push_front(victim);
+            where[victim] = { A1OUT, a1out.begin() };
+            while (a1out.size() > kout)
+            {
+                where.erase(a1out.back());
+                a1out.pop_back();
+            }
+        }
+        else
+        {
+            victim = am.back();
+            am.pop_back();
+            where.erase(victim);
+        }
+        return true;
+    }
+
+    void resized() override
+    {
+        kin  = cap / 4 ? cap / 4 : 1;
+        kout = cap / 2 ? cap / 2 : 1;
+    }
+
+private:
+    enum Queue { A1IN, A1OUT, AM };
+    struct Ref { Queue q; std::list<uint64_t>::iterator it; };
+
+    std::list<uint64_t>& list(Queue q) { return q == A1IN ? a1in : q == AM ? am : a1out; }
+
+    std::list<uint64_t>                a1in, a1out, am;   // front is newest
+    std::unordered_map<uint64_t, Ref>  where;
+    size_t                             kin = 1, kout = 1;
+};
+
+// ---------------------------------------------------------------------------
+// ARC (Megiddo, Modha 2003). T1 holds pages seen once recently, T2 pages
+// seen at least twice; B1 and B2 are their ghosts. A hit in B1 grows the
+// target size `p` of T1, a hit in B2 shrinks it.
+// ---------------------------------------------------------------------------
+class Arc : public PageTierPolicy
+{
+public:
+    explicit Arc(size_t capacity) : PageTierPolicy(capacity) {}
+
+    const char* name() const override { return "arc"; }
+
+    bool access(uint64_t page, uint64_t &victim, bool &evicted) override
+    {
+        evicted = false;
+        auto it = where.find(page);
+        if (it != where.end() && (it->second.q == T1 || it->second.q == T2))
+        {
+            move(it->second, T2);
+            return true;
+        }
+        if (it != where.end())
+        {
+            Ref &r = it->second;
+            bool inB2 = r.q == B2;
+            if (!inB2)
+            {
+                size_t d = b2.size() > b1.size() ? b2.size() / b1.size() : 1;
+                p = p + d < cap ? p + d : cap;
+            }
+            else
+            {
+                size_t d = b1.size() > b2.size() ? b1.size() / b2.size() : 1;
+                p = p > d ? p - d : 0;
+            }
+            if (size() >= cap) evicted = replace(inB2, victim);
+            move(r, T2);
+            return false;
+        }
+
+        size_t l1 = t1.size() + b1.size();
+        size_t all = l1 + t2.size() + b2.size();
+        if (l1 >= cap)
+        {
+            if (t1.size() < cap)
+            {
+                drop(b1);
+                if (size() >= cap) evicted = replace(false, victim);
+            }
+            else
+            {
+                victim = t1.back();
+                where.erase(victim);
+                t1.pop_back();
+                evicted = true;
+            }
+        }
+        else if (all >= cap)
+        {
+            if (all >= 2 * cap) drop(b2);
+            if (size() >= cap) evicted = replace(false, victim);
+        }
+        t1.push_front(page);
+        where[page] = { T1, t1.begin() };
+        return false;
+    }
+
+    bool contains(uint64_t page) const override
+    {
+        auto it = where.find(page);
+        return it != where.end() && (it->second.q == T1 || it->second.q == T2);
+    }
+
+    void remove(uint64_t page) override
+    {
+        auto it = where.find(page);
+        if (it == where.end()) return;
+        list(it->second.q).erase(it->second.it);
+        where.erase(it);
+    }
+
+    size_t size() const override { return t1.size() + t2.size(); }
+
+    void resident(std::vector<uint64_t> &out) const override
+    {
+        out.insert(out.end(), t1.begin(), t1.end());
+        out.insert(out.end(), t2.begin(), t2.end());
+    }
+
+protected:
+    bool evict(uint64_t &victim) override
+    {
+        if (!size()) return false;
+        return replace(false, victim);
+    }
+
+    void resized() override
+    {
+        if (p > cap) p = cap;
+        while (t1.size() + b1.size() > cap && !b1.empty()) drop(b1);
+        while (size() + b1.size() + b2.size() > 2 * cap && !b2.empty()) drop(b2);
+    }
+
+private:
+    enum Queue { T1, T2, B1, B2 };
+    struct Ref { Queue q; std::list<uint64_t>::iterator it; };
+
+    std::list<uint64_t>& list(Queue q)
+    {
+        return q == T1 ? t1 : q == T2 ? t2 : q == B1 ? b1 : b2;
+    }
+
+    void move(Ref &r, Queue to)
+    {
+        std::list<uint64_t> &dst = list(to);
+        dst.splice(dst.begin(), list(r.q), r.it);
+        r.q = to;
+    }
+
+    void drop(std::list<uint64_t> &ghost)
+    {
+        if (ghost.empty()) return;
+        where.erase(ghost.back());
+        ghost.pop_back();
+    }
+
+    // Move the LRU page of T1 or T2 to its ghost list.
+    bool replace(bool inB2, uint64_t &victim)
+    {
+        if (t1.empty() && t2.empty()) return false;
+        bool fromT1 = !t1.empty() && (t1.size() > p || (inB2 && t1.size() == p) || t2.empty());
+        Queue q = fromT1 ? T1 : T2;
+        victim = list(q).back();
+        move(where[victim], fromT1 ? B1 : B2);
+        return true;
+    }
+
+    std::list<uint64_t>                t1, t2, b1, b2;    // front is MRU
+    std::unordered_map<uint64_t, Ref>  where;
+    size_t                             p = 0;
+};
+
+// ---------------------------------------------------------------------------
+// LIRS (Jiang, Zhang 2002). Pages with a short reuse distance (LIR) own
+// ~99% of the tier; the rest holds resident HIR pages in queue Q, which
+// supplies every victim. Stack S orders pages by recency and is pruned so
+// its bottom is always LIR. A HIR page referenced while still in S has a
+// shorter reuse distance than the bottom LIR page, and they swap. Non-
+// resident HIR entries in S are capped at `cap`, oldest first.
+// ---------------------------------------------------------------------------
+class Lirs : public PageTierPolicy
+{
+public:
+    explicit Lirs(size_t capacity) : PageTierPolicy(capacity) { resized(); }
+
+    const char* name() const override { return "lirs"; }
+
+    bool access(uint64_t page, uint64_t &victim, bool &evicted) override
+    {
+        evicted = false;
+        auto it = where.find(page);
+        if (it != where.end() && it->second.resident)
+        {
+            Node &n = it->second;
+            if (n.lir) { to_top(page, n); prune(); return true; }
+            if (n.inS)
+            {
+                make_lir(page, n);
+                demote_bottom();
+            }
+            else
+            {
+                to_top(page, n);
+                q.splice(q.begin(), q, n.qi);
+            }
+            return true;
+        }
+
+        if (nlir + q.size() >= cap) evicted = evict(victim);
+        it = where.find(page);
+        if (it == where.end() && nlir < llir)
+        {
+            Node &n = where[page];
+            n.resident = true;
+            to_top(page, n);
+            n.lir = true;
+            ++nlir;
+            return false;
+        }
+        if (it != where.end())
+        {
+            // non-resident HIR still in S: it becomes LIR
+            Node &n = it->second;
+            ghosts.erase(n.gi);
+            n.resident = true;
+            make_lir(page, n);
+            demote_bottom();
+        }
+        else
+        {
+            Node &n = where[page];
+            n.resident = true;
+            to_top(page, n);
+            q.push_front(page);
+            n.qi = q.begin(); n.inQ = true;
+        }
+        return false;
+    }
+
+    bool contains(uint64_t page) const override
+    {
+        auto it = where.find(page);
+        return it != where.end() && it->second.resident;
+    }
+
+    void remove(uint64_t page) override
+    {
+        auto it = where.find(page);
+        if (it == where.end()) return;
+        Node &n = it->second;
+        if (n.lir) --nlir;
+        if (n.inS) s.erase(n.si);
+        if (n.inQ) q.erase(n.qi);
+        if (!n.resident) ghosts.erase(n.gi);
+        where.erase(it);
+        prune();
+    }
+
+    size_t size() const override { return nlir + q.size(); }
+
+    void resident(std::vector<uint64_t> &out) const override
+    {
+        for (auto &w : where) if (w.second.resident) out.push_back(w.first);
+    }
+
+protected:
+    bool evict(uint64_t &victim) override
+    {
+        if (q.empty() && nlir) demote_bottom();
+        if (q.empty()) return false;
+        victim = q.back();
+        q.pop_back();
+        Node &n = where[victim];
+        n.inQ = false;
+        n.resident = false;
+        if (!n.inS) { where.erase(victim); return true; }
+        ghosts.push_front(victim);
+        n.gi = ghosts.begin();
+        while (ghosts.size() > cap)
+        {
+            uint64_t g = ghosts.back();
+            ghosts.pop_back();
+            Node &o = where[g];
+            s.erase(o.si);
+            where.erase(g);
+        }
+        return true;
+    }
+
+    void resized() override
+    {
+        size_t lhirs = cap / 100 ? cap / 100 : 1;
+        llir = cap > lhirs ? cap - lhirs : 1;
+        while (nlir > llir) demote_bottom();
+    }
+
+private:
+    typedef std::list<uint64_t>::iterator Pos;
+    struct Node
+    {
+        bool lir = false, resident = false, inS = false, inQ = false;
+        Pos  si, qi, gi;
+    };
+
+    void to_top(uint64_t page, Node &n)
+    {
+        if (n.inS) s.splice(s.begin(), s, n.si);
+        else { s.push_front(page); n.si = s.begin(); n.inS = true; }
+    }
+
+    void make_lir(uint64_t page, Node &n)
+    {
+        to_top(page, n);
+        if (n.inQ) { q.erase(n.qi); n.inQ = false; }
+        n.lir = true;
+        ++nlir;
+    }
+
+    // The bottom LIR page becomes a resident HIR page at the end of Q.
+    void demote_bottom()
+    {
+        prune();
+        if (s.empty()) return;
+        uint64_t b = s.back();
+        Node &n = where[b];
+        s.pop_back();
+        n.inS = false;
+        n.lir = false;
+        --nlir;
+        q.push_front(b);
+        n.qi = q.begin(); n.inQ = true;
+        prune();
+    }
+
+    // Pop HIR entries off the bottom of S until a LIR page is there.
+    void prune()
+    {
+        while (!s.empty())
+        {
+            uint64_t b = s.back();
+            Node &n = where[b];
+            if (n.lir) break;
+            s.pop_back();
+            n.inS = false;
+            if (!n.resident) { ghosts.erase(n.gi); where.erase(b); }
+        }
+    }
+
+    std::list<uint64_t>                 s, q, ghosts;   // front is newest
+    std::unordered_map<uint64_t, Node>  where;
+    size_t                              nlir = 0, llir = 1;
+};
+
+// ---------------------------------------------------------------------------
+// Multi-generational LRU in the style of Linux MGLRU. Pages live in up to
+// NR_GENS generations, max_seq the youngest and min_seq the oldest. New
+// pages join the youngest. Eviction walks the oldest generation: a page
+// referenced since it got there (its accessed bit) is promoted to max_seq
+// instead, and an emptied oldest generation retires. Aging opens a new
+// generation whenever fewer than MIN_NR_GENS remain, so a referenced page
+// always has somewhere younger to go.
+// ---------------------------------------------------------------------------
+class Mglru : public PageTierPolicy
+{
+public:
+    static constexpr uint32_t NR_GENS     = 4;
+    static constexpr uint32_t MIN_NR_GENS = 2;
+
+    explicit Mglru(size_t capacity) : PageTierPolicy(capacity) {}
+
+    const char* name() const override { return "mglru"; }
+
+    bool access(uint64_t page, uint64_t &victim, bool &evicted) override
+    {
+        evicted = false;
+        auto it = where.find(page);
+        if (it != where.end()) { it->second.ref = true; return true; }
+        if (where.size() >= cap) evicted = evict(victim);
+        // a full generation's worth of new pages is one aging interval
+        if (gen(max_seq).size() >= cap / NR_GENS + 1) age();
+        std::list<uint64_t> &g = gen(max_seq);
+        g.push_front(page);
+        where[page] = { g.begin(), max_seq, false };
+        return false;
+    }
+
+    bool contains(uint64_t page) const override { return where.count(page) != 0; }
+
+    void remove(uint64_t page) override
+    {
+        auto it = where.find(page);
+        if (it == where.end()) return;
+        gen(it->second.seq).erase(it->second.it);
+        where.erase(it);
+    }
+
+    size_t size() const override { return where.size(); }
+
+    void resident(std::vector<uint64_t> &out) const override
+    {
+        for (auto &w : where) out.push_back(w.first);
+    }
+
+    uint64_t min_gen() const { return min_seq; }
+    uint64_t max_gen() const { return max_seq; }
+
+protected:
+    bool evict(uint64_t &victim) override
+    {
+        if (where.empty()) return false;
+        for (;;)
+        {
+            std::list<uint64_t> &old = gen(min_seq);
+            if (old.empty())
+            {
+                ++min_seq;
+                if (max_seq - min_seq + 1 < MIN_NR_GENS) age();
+                continue;
+            }
+            uint64_t page = old.back();
+            Page &pg = where[page];
+            if (pg.ref)
+            {
+                // promote, clearing the accessed bit
+                if (min_seq == max_seq) age();
+                pg.ref = false;
+                std::list<uint64_t> &young = gen(max_seq);
+                young.splice(young.begin(), old, pg.it);
+                pg.seq = max_seq;
+                continue;
+            }
+            old.pop_back();
+            where.erase(page);
+            victim = page;
+            return true;
+        }
+    }
+
+private:
+    struct Page { std::list<uint64_t>::iterator it; uint64_t seq; bool ref; };
+
+    std::list<uint64_t>& gen(uint64_t seq) { return gens[seq % NR_GENS]; }
+
+    // Open a new youngest generation if the ring has room.
+    void age()
+    {
+        if (max_seq - min_seq + 1 < NR_GENS) ++max_seq;
+    }
+
+    std::list<uint64_t>                gens[NR_GENS];   // front is newest
+    std::unordered_map<uint64_t, Page> where;
+    uint64_t                           min_seq = 0, max_seq = 1;
+};
+
+// ---------------------------------------------------------------------------
+// Build a policy by name; nullptr for an unknown name. "promote" is not
+// here: it is the simulator's built-in two-list scheme.
+// ---------------------------------------------------------------------------
+inline PageTierPolicy* make_policy(const char *name, size_t capacity)
+{
+    if (!strcmp(name, "clock"))    return new Clock(capacity);
+    if (!strcmp(name, "clockpro")) return new ClockPro(capacity);
+    if (!strcmp(name, "2q"))       return new TwoQ(capacity);
+    if (!strcmp(name, "arc"))      return new Arc(capacity);
+    if (!strcmp(name, "lirs"))     return new Lirs(capacity);
+    if (!strcmp(name, "mglru"))    return new Mglru(capacity);
+    return nullptr;
+}
+
+} // namespace TIERPOLICY
+
+#endif /* TIERPOLICY_H */
@@ -0,0 +1,112 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "tierpolicy.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Size, victims, resident() agree   o
+// Resize / remove_range             o
+// CLOCK second chance               o
+// Scan resistance (2Q, ARC, LIRS,   o
+//   CLOCK-Pro)
+// MGLRU promotes referenced pages   o
+// -----------------------------------------------------------------------
+
+using namespace TIERPOLICY;
+
+static const char* names[] = { "clock", "clockpro", "2q", "arc", "lirs", "mglru" };
+
+static bool touch(PageTierPolicy &p, uint64_t page)
+{
+    uint64_t v; bool ev;
+    return p.access(page, v, ev);
+}
+
+// Mixed looping/random trace; checks the invariants after every access.
+static void invariants(const char *name)
+{
+    const size_t cap = 64;
+    std::unique_ptr<PageTierPolicy> p(make_policy(name, cap));
+    assert(p && p->capacity() == cap);
+    uint64_t x = 12345;
+    for (int i = 0; i < 20000; ++i)
+    {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t page = (i & 1) ? (x >> 33) % 200 : i % 90;
+        size_t before = p->size();
+        uint64_t v; bool ev;
+        bool hit = p->access(page, v, ev);
+        assert(p->contains(page));
+        assert(p->size() <= cap);
+        if (hit) assert(!ev && p->size() == before);
+        if (ev) assert(v != page && !p->contains(v) && p->size() == before);
+        if (!hit && !ev) assert(p->size() == before + 1);
+    }
+    std::vector<uint64_t> in;
+    p->resident(in);
+    assert(in.size() == p->size());
+    for (uint64_t q : in) assert(p->contains(q));
+
+    std::vector<uint64_t> out;
+    p->resize(16, out);
+    assert(p->size() <= 16 && out.size() == in.size() - p->size());
+    for (uint64_t q : out) assert(!p->contains(q));
+    for (int i = 0; i < 1000; ++i) touch(*p, i % 40);
+    assert(p->size() == 16);
+
+    p->remove_range(0, 1000);
+    assert(p->size() == 0);
+    for (uint64_t q = 0; q < 12; ++q) touch(*p, q);
+    p->remove_range(5, 10);
+    assert(p->size() == 7 && !p->contains(7) && p->contains(4) && p->contains(11));
+}
+
+// Hot set of 8 pages touched twice, then a long one-touch scan.
+static size_t survivors(const char *name)
+{
+    std::unique_ptr<PageTierPolicy> p(make_policy(name, 32));
+    for (int r = 0; r < 4; ++r)
+        for (uint64_t h = 0; h < 8; ++h) touch(*p, h);
+    for (uint64_t s = 1000; s < 1200; ++s)
+    {
+        touch(*p, s);
+        if (s % 8 == 0)
+            for (uint64_t h = 0; h < 8; ++h) touch(*p, h);
+    }
+    for (uint64_t s = 2000; s < 2100; ++s) touch(*p, s);
+    size_t n = 0;
+    for (uint64_t h = 0; h < 8; ++h) n += p->contains(h);
+    return n;
+}
+
+int main()
+{
+    for (const char *n : names) invariants(n);
+    assert(!make_policy("promote", 8));
+
+    // CLOCK: a referenced page survives one sweep of the hand
+    Clock c(3);
+    uint64_t v; bool ev;
+    touch(c, 1); touch(c, 2); touch(c, 3);
+    c.access(4, v, ev);                 // every bit set: full sweep, takes 1
+    assert(ev && v == 1);
+    touch(c, 2);                        // 2 referenced again
+    c.access(5, v, ev);
+    assert(ev && v == 3);
+
+    for (const char *n : { "2q", "arc", "lirs", "clockpro" })
+        assert(survivors(n) == 8);
+
+    // MGLRU: the referenced page is promoted and outlives younger ones
+    Mglru g(4);
+    for (uint64_t q = 1; q <= 4; ++q) touch(g, q);
+    touch(g, 1);
+    g.access(5, v, ev);
+    assert(ev && v == 2 && g.contains(1));
+    assert(g.max_gen() - g.min_gen() + 1 <= Mglru::NR_GENS);
+
+    std::cout << "tierpolicy ok" << std::endl;
+    return 0;
+}
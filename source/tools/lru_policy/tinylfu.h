@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if !defined(TINYLFU_H)
+#define TINYLFU_H
+
+namespace TINYLFU
+{
+
+// ---------------------------------------------------------------------------
+// TinyLFU frequency sketch (Einziger, Friedman, Manes 2017): a Count-Min
+// Sketch of 4-bit counters, DEPTH rows of `width` counters packed 16 to a
+// word, in front of which sits a one-bit doorkeeper, so that a key seen
+// once costs a single bit. After `sample` recorded accesses every counter
+// is halved and the doorkeeper cleared, so the estimate follows recent
+// popularity instead of all-time counts.
+//
+// Width is the next power of two (at least 64) at or above the number of
+// pages the caller wants to track; the sample is SAMPLE_FACTOR times that
+// number.
+// ---------------------------------------------------------------------------
+class Sketch
+{
+public:
+    static constexpr uint32_t DEPTH         = 4;
+    static constexpr uint32_t MAX_COUNT     = 15;
+    static constexpr uint32_t SAMPLE_FACTOR = 10;
+
+    explicit Sketch(uint64_t pages)
+    {
+        width = 64;
+        while (width < pages) width <<= 1;
+        table.assign(DEPTH * width / 16, 0);
+        door.assign(width / 64, 0);
+        sample = SAMPLE_FACTOR * (pages ? pages : 1);
+    }
+
+    // One access to `key`.
+    void record(uint64_t key)
+    {
+        if (++additions >= sample) halve();
+        if (!door_test_and_set(key)) return;
+        for (uint32_t r = 0; r < DEPTH; ++r)
+        {
+            uint64_t &w = table[word(r, key)];
+            uint32_t sh = shift(r, key);
+            if (((w >> sh) & 0xf) < MAX_COUNT) w += 1ULL << sh;
+        }
+    }
+
+    // Estimated recent accesses to `key` (0..MAX_COUNT + 1).
+    uint32_t estimate(uint64_t key) const
+    {
+        uint32_t est = MAX_COUNT;
+        for (uint32_t r = 0; r < DEPTH; ++r)
+        {
+            uint32_t c = (table[word(r, key)] >> shift(r, key)) & 0xf;
+            if (c < est) est = c;
+        }
+        return est + (door_test(key) ? 1 : 0);
+    }
+
+    // TinyLFU admission: the candidate replaces the victim only if it is
+    // more popular.
+    bool admit(uint64_t candidate, uint64_t victim) const
+    {
+        return estimate(candidate) > estimate(victim);
+    }
+
+    uint64_t resets() const { return resets_; }
+
+    // Raw state, for checkpoints.
+    const std::vector<uint64_t>& counters()   const { return table; }
+    const std::vector<uint64_t>& doorkeeper() const { return door; }
+    uint64_t sampled() const { return additions; }
+    bool load(const uint64_t *t, uint64_t nt, const uint64_t *d, uint64_t nd, uint64_t added)
+    {
+        if (nt != table.size() || nd != door.size()) return false;
+        table.assign(t, t + nt);
+        door.assign(d, d + nd);
+        additions = added;
+        return true;
+    }
+
+private:
+    static uint64_t mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t index(uint32_t r, uint64_t key) const
+    {
+        return mix(key + r * 0x51ed270b27a3f1c5ULL) & (width - 1);
+    }
+    size_t   word(uint32_t r, uint64_t key)  const { return (r * width + index(r, key)) / 16; }
+    uint32_t shift(uint32_t r, uint64_t key) const { return (uint32_t)(index(r, key) % 16) * 4; }
+
+    // Two bits per key in the doorkeeper; true if both were already set.
+    bool door_test(uint64_t key) const
+    {
+        uint64_t h = mix(key ^ 0xd6e8feb86659fd93ULL);
+        uint64_t a = h & (width - 1), b = (h >> 32) & (width - 1);
+        return (door[a / 64] >> (a % 64) & 1) && (door[b / 64] >> (b % 64) & 1);
+    }
+
+    bool door_test_and_set(uint64_t key)
+    {
+        if (door_test(key)) return true;
+        uint64_t h = mix(key ^ 0xd6e8feb86659fd93ULL);
+        uint64_t a = h & (width - 1), b = (h >> 32) & (width - 1);
+        door[a / 64] |= 1ULL << (a % 64);
+        door[b / 64] |= 1ULL << (b % 64);
+        return false;
+    }
+
+    void halve()
+    {
+        for (auto &w : table) w = (w >> 1) & 0x7777777777777777ULL;
+        for (auto &d : door) d = 0;
+        additions = 0;
+        ++resets_;
+    }
+
+    uint64_t              width = 64, sample = 1, additions = 0, resets_ = 0;
+    std::vector<uint64_t> table;    // DEPTH rows of width 4-bit counters
+    std::vector<uint64_t> door;     // width bits
+};
+
+} // namespace TINYLFU
+
+#endif /* TINYLFU_H */
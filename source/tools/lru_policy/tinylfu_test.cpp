@@ -0,0 +1,50 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include "tinylfu.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// First access only sets the doorkeeper   o
+// Counts saturate at 15                   o
+// Popular page beats a one-shot scan      o
+// Periodic halving                        o
+// Checkpoint load                         o
+// -----------------------------------------------------------------------
+
+using namespace TINYLFU;
+
+int main()
+{
+    Sketch s(1024);
+    assert(s.estimate(7) == 0);
+    s.record(7);
+    assert(s.estimate(7) == 1);                     // doorkeeper only
+    s.record(7);
+    assert(s.estimate(7) == 2);
+    for (int i = 0; i < 40; ++i) s.record(7);
+    assert(s.estimate(7) == Sketch::MAX_COUNT + 1);
+
+    // a scan of one-shot pages never outranks the hot page
+    for (uint64_t p = 100000; p < 101000; ++p)
+    {
+        s.record(p);
+        assert(s.admit(7, p) && !s.admit(p, 7));
+    }
+    assert(s.resets() == 0);
+
+    // 10 x 1024 accesses trigger a reset: counts halve, doorkeeper clears
+    for (uint64_t i = 0; i < 10 * 1024; ++i) s.record(200000 + i % 5000);
+    assert(s.resets() == 1);
+    assert(s.estimate(7) <= (Sketch::MAX_COUNT + 1) / 2);
+
+    Sketch t(1024);
+    assert(t.load(s.counters().data(), s.counters().size(),
+                  s.doorkeeper().data(), s.doorkeeper().size(), s.sampled()));
+    assert(t.estimate(7) == s.estimate(7));
+    Sketch u(64);
+    assert(!u.load(s.counters().data(), s.counters().size(),
+                   s.doorkeeper().data(), s.doorkeeper().size(), 0));
+
+    std::cout << "tinylfu ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if !defined(TLBSIM_H)
+#define TLBSIM_H
+
+namespace TLBSIM
+{
+
+// ---------------------------------------------------------------------------
+// Set-associative translation cache with LRU replacement. Keys are opaque
+// to it (the caller folds page size and level into them), so the same class
+// serves as L1 dTLB/iTLB, shared L2 TLB and page-walk cache.
+// ---------------------------------------------------------------------------
+class Tlb
+{
+public:
+    Tlb(uint32_t entries, uint32_t assoc)
+        : ways(assoc ? assoc : 1),
+          sets(entries / ways ? entries / ways : 1),
+          slots(sets * ways) {}
+
+    // Look a key up; a hit makes it MRU in its set.
+    bool lookup(uint64_t key)
+    {
+        Entry *w = &slots[(key % sets) * ways];
+        ++clock;
+        for (uint32_t i = 0; i < ways; ++i)
+            if (w[i].valid && w[i].key == key)
+            {
+                w[i].stamp = clock;
+                ++hit;
+                return true;
+            }
+        ++miss;
+        return false;
+    }
+
+    // Fill after a miss, replacing an invalid or the LRU entry of the set.
+    void insert(uint64_t key)
+    {
+        Entry *w = &slots[(key % sets) * ways];
+        Entry *victim = &w[0];
+        for (uint32_t i = 0; i < ways; ++i)
+        {
+            if (!w[i].valid) { victim = &w[i]; break; }
+            if (w[i].stamp < victim->stamp) victim = &w[i];
+        }
+        *victim = { key, ++clock, true };
+    }
+
+    // Drop everything (e.g. a full shootdown).
+    void flush() { for (auto &e : slots) e.valid = false; }
+
+    uint64_t hits()   const { return hit;  }
+    uint64_t misses() const { return miss; }
+    void reset_stats()      { hit = miss = 0; }
+
+private:
+    struct Entry { uint64_t key = 0; uint64_t stamp = 0; bool valid = false; };
+
+    uint32_t           ways;
+    uint32_t           sets;
+    std::vector<Entry> slots;
+    uint64_t           clock = 0;
+    uint64_t           hit = 0, miss = 0;
+};
+
+// ---------------------------------------------------------------------------
+// x86-64 4-level radix layout. Level 1 is the PML4, level 4 the last-level
+// page table; a 2 MiB mapping ends at level 3. Each level's entries are laid
+// out contiguously from its own base in `region`, indexed by the address
+// bits above that level, so neighbouring pages share PTE lines exactly as
+// in a real page table.
+// ---------------------------------------------------------------------------
+constexpr uint32_t LEVELS = 4;
+
+inline uint32_t level_shift(uint32_t level) { return 12 + 9 * (LEVELS - level); }
+
+inline uint64_t pte_addr(uint64_t region, uint32_t level, uint64_t vaddr)
+{
+    uint64_t va = vaddr & ((1ULL << 48) - 1);
+    return region + (uint64_t(level) << 40) + (va >> level_shift(level)) * 8;
+}
+
+} // namespace TLBSIM
+
+#endif /* TLBSIM_H */
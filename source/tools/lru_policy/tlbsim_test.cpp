@@ -0,0 +1,39 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include "tlbsim.h"
+// -----------------------------------------------------------------------
+// Testing checklist:
+// Hit after fill           o
+// LRU victim within a set  o
+// Flush                    o
+// PTE address layout       o
+// -----------------------------------------------------------------------
+
+int main()
+{
+    TLBSIM::Tlb tlb(8, 2);                  // 4 sets x 2 ways
+    assert(!tlb.lookup(1));
+    tlb.insert(1);
+    assert(tlb.lookup(1));
+
+    tlb.insert(5);                          // same set as 1
+    assert(tlb.lookup(1));                  // 1 is now MRU
+    tlb.insert(9);                          // evicts 5
+    assert(tlb.lookup(1) && tlb.lookup(9) && !tlb.lookup(5));
+    assert(tlb.hits() == 4 && tlb.misses() == 2);
+
+    tlb.flush();
+    assert(!tlb.lookup(1));
+
+    const uint64_t region = 0xffff900000000000ULL;
+    uint64_t a = 0x7f0000001000ULL;
+    // neighbouring 4 KiB pages share a PTE line, not a PD entry's page
+    assert(TLBSIM::pte_addr(region, 4, a + 4096) - TLBSIM::pte_addr(region, 4, a) == 8);
+    assert(TLBSIM::pte_addr(region, 3, a + 4096) == TLBSIM::pte_addr(region, 3, a));
+    assert(TLBSIM::pte_addr(region, 3, a + (2 << 20)) - TLBSIM::pte_addr(region, 3, a) == 8);
+    assert(TLBSIM::pte_addr(region, 1, a) < TLBSIM::pte_addr(region, 2, a));
+
+    std::cout << "tlb ok" << std::endl;
+    return 0;
+}